@@ -20,18 +20,32 @@
 #include <iomanip>
 #include <utility>
 #include <ctime>
+#include <csignal>
+#include <cstdio>
 #include <cstring>
 #include "all_alignment.h"
+#include "anti_diagonal.h"
+#include "batch_biased.h"
+#include "bit_parallel.h"
+#include "checkpoint.h"
 #include "constituent.h"
 #include "edit_distance.h"
 #include "edit_operations.h"
+#include "hypotheses.h"
+#include "minhash.h"
 #include "nonterminal.h"
+#include "postings.h"
+#include "prefilter.h"
 #include "sentence.h"
+#include "shard.h"
+#include "stats.h"
 #include "tools.h"
 #include "treebank.h"
 #include "wagner_fisher.h"
 #include "config.h"
+#include "suffixarray.h"
 #include "suffixtree.h"
+#include "thread_pool.h"
 
 #define TIMING (HAVE_SIGNAL_H && HAVE_UNISTD_H)
 
@@ -80,29 +94,60 @@ cannot implement long option handling
 } // extern "C"
 #endif // #ifdef HAVE_GETOPT_H #else
 
+using namespace ns_checkpoint;
 using ns_constituent::Constituent;
 using namespace ns_edit_distance;
+using namespace ns_hypotheses;
+using ns_minhash::Lsh;
 using ns_nonterminal::Nonterminal;
+using namespace ns_postings;
+using namespace ns_prefilter;
 using ns_sentence::Sentence;
+using namespace ns_shard;
+using ns_stats::Histogram;
+using ns_stats::Stats;
+using ns_stats::wall_time;
 using ns_treebank::Treebank;
+using ns_suffixarray::Suffixarray;
 using namespace ns_suffixtree;
+using namespace ns_thread_pool;
 using ns_tools::error;
 using ns_tools::warning;
 using ns_tools::debug;
 using ns_tools::getDate;
 
 static struct option long_options[] = {
+   {"aa_fallback", required_argument, 0, 'K'},
+   {"aa_max_alignments", required_argument, 0, 'A'},
+   {"aa_max_time", required_argument, 0, 'M'},
    {"align", required_argument, 0, 'a'},
+   {"band", required_argument, 0, 'w'},
+   {"base", required_argument, 0, 'b'},
+   {"candidates", required_argument, 0, 'C'},
    {"debug", no_argument, 0, 'd'},
    {"excl_empty", no_argument, 0, 'e'},
    {"help", no_argument, 0, 'h'},
    {"input", required_argument, 0, 'i'},
+   {"linear_space", required_argument, 0, 'l'},
+   {"lsh_bands", required_argument, 0, 'B'},
+   {"lsh_rows", required_argument, 0, 'R'},
+   {"lsh_shingle", required_argument, 0, 'N'},
+   {"max_distance", required_argument, 0, 'k'},
+   {"max_frequency", required_argument, 0, 'F'},
+   {"min_overlap", required_argument, 0, 'f'},
+   {"min_shared", required_argument, 0, 'u'},
    {"output", required_argument, 0, 'o'},
    {"part", required_argument, 0, 'p'},
    {"nomerging", no_argument, 0, 'n'},
    {"seed", required_argument, 0, 's'},
+   {"shard", required_argument, 0, 'S'},
+   {"stats", required_argument, 0, 'T'},
+   {"suffix_array", no_argument, 0, 'y'},
+   {"threads", required_argument, 0, 'j'},
    {"time", required_argument, 0, 't'},
    {"check", required_argument, 0, 'c'},
+   {"resume", required_argument, 0, 'r'},
+   {"collapse", no_argument, 0, 'D'},
    {"verbose", no_argument, 0, 'v'},
    {"version", no_argument, 0, 'V'},
    {"exhaustive", no_argument, 0, 'x'},
@@ -117,15 +162,22 @@ ostream *ofs=&cout;
 enum Align_type {UNDEF, WM, WB, FM, FB, AA, L, R, B, ST1, ST2, ST3, ST4};
 // Chosen alignment (defaults to undefined).
 Align_type align_type=UNDEF;
-// Parts of the sentences that should be hypotheses.
-enum Part_type {EQUAL, UNEQUAL, BOTH};
-// Chosen part of the sentences that should be hypotheses. (default to
-// unequal)
-Part_type part_type=UNEQUAL;
+// Return true if the alignment type aligns pairs of sentences (wm, wb and
+// aa), which go through the selection of candidates and the window.
+inline bool aligns_pairs() throw() {
+   return (align_type == WM)||(align_type == WB)||(align_type == AA);
+}
+// Inserts the hypotheses: the chosen part of the sentences that should be
+// hypotheses (defaults to unequal), the nomerge flag, whether to exclude
+// empty hypotheses (where B == E) and the number of hypotheses generated.
+Hypotheses hypotheses;
 // 0 is the startsymbol (initial nonterminal type).
 const int startsymbol=0;
-// Nomerge flag.
-bool nomerge_flag=false;
+// Align each distinct sentence once (wm, wb and aa only)
+bool collapse_flag=false;
+// With collapse: the first and the last position in the input of the
+// sentence of each tree
+vector<int> first_copy, last_copy;
 // Name of the program as it was called.
 string program_name;
 // Print debug information.
@@ -134,23 +186,98 @@ bool debug_flag=false;
 unsigned int timer=0;
 // Prefix string
 string tmp_prefix("abl_align");
+// Set by the alarm: a checkpoint is taken at the next safe point
+volatile sig_atomic_t checkpoint_due=0;
+// Writes the checkpoints (0 when no checkpoints are taken)
+Checkpoint_writer* checkpoints=0;
+// Checkpoint to resume from. The resumed run continues with pair
+// resume_pairs of sentence resume_row: the pairs before that are in the
+// treebank already.
+string resume_file;
+Treebank::size_type resume_row=0;
+int resume_pairs=0;
 // Global treebank: this is where all the data is stored
 Treebank tb;
-// Exclude empty hypotheses (where B == E)
-bool excl_empty=false;
 // Print aligning information
 bool verbose_flag=false;
 // Do exhaustive comparisons: N(N-1)/2
 bool exhaustive_flag=false;
-// Counter for number of constituent hypotheses being generated
-int consts_cnt=0;
+// Use a suffix array instead of a suffix tree (st1 to st4)
+bool suffix_array_flag=false;
+// Maximum edit cost of a pair that is aligned (negative means no maximum)
+float max_distance=-1;
+// Half width of the diagonal band in the edit distance matrix (negative
+// means the full matrix is filled)
+int band=-1;
+// Pairs with larger edit distance matrices are aligned in linear space
+double max_cells=16777216;
+// Counter for number of sentence pairs that are abandoned
+int abandoned_cnt=0;
+// Counters of the sentence pairs for the statistics: found by the
+// candidate generation, left out by the prefilters or for another shard,
+// and aligned, with the cells of their edit distance matrices that were
+// computed
+long considered_cnt=0;
+long skipped_cnt=0;
+long aligned_cnt=0;
+long cells_cnt=0;
+// Figures of the run and the file they are written to (empty means none)
+Stats stats;
+string stats_file;
+// Budgets of a pair in the all alignments mode: the number of alignments
+// and the microseconds (0 means no budget). A pair that exceeds one is
+// given its aa_fallback best alignments instead, or the wagner_min
+// alignment when aa_fallback is 0.
+double aa_max_alignments=0;
+double aa_max_time=0;
+int aa_fallback=0;
+// Counters of the pairs that exceeded the budgets
+long over_alignments_cnt=0;
+long over_time_cnt=0;
+// Pairs with fewer words in common are not aligned (0 means no minimum)
+int min_overlap=0;
+// Prefilters of the sentence pairs (wm, wb and aa only) and the bags of
+// words of the sentences in the treebank they look at
+Prefilter_chain prefilters;
+vector<Bag> bags;
+// Ways of finding the sentences a sentence is aligned with (wm, wb and aa
+// only, not with exhaustive comparison)
+enum Candidate_type {INDEX, LSH};
+// Chosen way (defaults to the index of the sentences each word occurs in).
+Candidate_type candidate_type=INDEX;
+Postings postings;
+Lsh lsh;
+// Number of threads that align sentence pairs
+int threads=1;
+// Shard k of N (shard, shards) of the sentence pairs that is aligned
+// (wm and wb only, 0 shards means all pairs)
+int shard=0;
+int shards=0;
+// Writer of the events of a shard, the sentences that got the start
+// symbol from an earlier sentence, and the counter of the pairs that are
+// left out because they change nothing (see changes)
+Event_writer* events=0;
+vector<bool> spanned;
+long left_out_cnt=0;
+// Aligned treebank that the sentences of the input are added to (wm, wb
+// and aa only, 0 means none). Its sentences come before first_new in the
+// treebank and are only aligned with the new sentences.
+istream *base_ifs=0;
+Treebank::size_type first_new=0;
+
 
+struct Scratch {
+   // This class holds the scratch space of the aligners (reused for all
+   // pairs). Every thread has its own.
+   Dp_buffer dp_buffer;
+   Ad_buffer ad_buffer;
+   Batch_buffer batch_buffer;
+   Histogram latency;   // nanoseconds per aligned pair
+};
 
-typedef Edit_distance Edit_distance_sen;
-typedef Del<Sentence::const_iterator> del;
-typedef Ins<Sentence::const_iterator> ins;
-typedef Sub<Sentence::const_iterator> sub;
-typedef Sub_dis<Sentence::const_iterator> sub_dis;
+// The threads that align sentence pairs and their scratch space
+Thread_pool* pool=0;
+vector<Scratch> scratch;
 
 class Rand {
 // This class is a wrapper around a random number generator. It is
@@ -193,6 +320,12 @@ void usage() {
    cerr << "Name of input file (- means stdin, default)" << endl;
    cerr << "  -o, --output=FILE  ";
    cerr << "Name of output file (- means stdout, default)" << endl;
+   cerr << "  -b, --base=FILE    ";
+   cerr << "Aligned treebank that the sentences of the input file are" << endl;
+   cerr << "                     ";
+   cerr << "added to: only pairs with a new sentence are aligned (wm," << endl;
+   cerr << "                     ";
+   cerr << "wb and aa only)" << endl;
    cerr << "  -a, --align=TYPE   ";
    cerr << "TYPE is one of:" << endl;
    cerr << "                       - wagner_min, wm:" << endl;
@@ -230,20 +363,115 @@ void usage() {
    cerr << "                           unequal parts" << endl;
    cerr << "                       - both, b:" << endl;
    cerr << "                           equal and unequal parts" << endl;
+   cerr << "  -k, --max_distance NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Do not align pairs with a higher edit cost (wm and wb only)" << endl;
+   cerr << "  -w, --band NUMBER  ";
+   cerr << "Only fill a diagonal band of this half width in the edit" << endl;
+   cerr << "                     ";
+   cerr << "distance matrix (wm and wb only)" << endl;
+   cerr << "  -f, --min_overlap NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Do not align pairs with fewer words in common (wm, wb and" << endl;
+   cerr << "                     ";
+   cerr << "aa only)" << endl;
+   cerr << "  -F, --max_frequency PERCENT" << endl;
+   cerr << "                     ";
+   cerr << "Ignore words that occur in more than PERCENT of the" << endl;
+   cerr << "                     ";
+   cerr << "sentences when looking for sentences to align with (wm," << endl;
+   cerr << "                     ";
+   cerr << "wb and aa only, defaults to 100)" << endl;
+   cerr << "  -u, --min_shared NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Only align sentences with at least NUMBER distinct words" << endl;
+   cerr << "                     ";
+   cerr << "in common, not counting ignored ones (wm, wb and aa only," << endl;
+   cerr << "                     ";
+   cerr << "defaults to 1)" << endl;
+   cerr << "  -C, --candidates=TYPE" << endl;
+   cerr << "                     ";
+   cerr << "How to find the sentences to align with (wm, wb and aa" << endl;
+   cerr << "                     ";
+   cerr << "only)" << endl;
+   cerr << "                       - index:" << endl;
+   cerr << "                           sentences with words in common" << endl;
+   cerr << "                           (default)" << endl;
+   cerr << "                       - lsh:" << endl;
+   cerr << "                           sentences with MinHash signatures" << endl;
+   cerr << "                           in the same bucket" << endl;
+   cerr << "  -B, --lsh_bands NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Number of bands of the signatures (lsh only, defaults to" << endl;
+   cerr << "                     ";
+   cerr << "20)" << endl;
+   cerr << "  -R, --lsh_rows NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Number of values in a band (lsh only, defaults to 5)" << endl;
+   cerr << "  -N, --lsh_shingle NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Number of words in a shingle (lsh only, defaults to 1)" << endl;
+   cerr << "  -j, --threads NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Number of threads that align sentence pairs (wm, wb and" << endl;
+   cerr << "                     ";
+   cerr << "aa only, defaults to 1)" << endl;
+   cerr << "  -l, --linear_space NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Align pairs with larger edit distance matrices in linear" << endl;
+   cerr << "                     ";
+   cerr << "space (wm and wb only, defaults to 16777216 cells)" << endl;
+   cerr << "  -S, --shard K/N    ";
+   cerr << "Align shard K of N of the sentence pairs and write the" << endl;
+   cerr << "                     ";
+   cerr << "alignments for abl_merge (wm and wb only)" << endl;
+   cerr << "  -A, --aa_max_alignments NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Pairs with more alignments get their fallback alignments" << endl;
+   cerr << "                     ";
+   cerr << "(aa only, defaults to no maximum)" << endl;
+   cerr << "  -M, --aa_max_time NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Pairs whose alignments take more microseconds get their" << endl;
+   cerr << "                     ";
+   cerr << "fallback alignments (aa only, defaults to no maximum)" << endl;
+   cerr << "  -K, --aa_fallback NUMBER" << endl;
+   cerr << "                     ";
+   cerr << "Number of alignments with the lowest edit cost that a pair" << endl;
+   cerr << "                     ";
+   cerr << "over budget gets, 0 means the wagner_min alignment (aa" << endl;
+   cerr << "                     ";
+   cerr << "only, defaults to 0)" << endl;
    cerr << "  -s, --seed NUMBER  ";
    cerr << "Seed (for the both alignment type)" << endl;
 #if TIMING
    cerr << "  -t, --time NUMBER  ";
-   cerr << "Number of seconds between each checkpoint" << endl;
+   cerr << "Number of seconds between each checkpoint (wm, wb and aa" << endl;
+   cerr << "                     ";
+   cerr << "only)" << endl;
    cerr << "  -c, --check string ";
-   cerr << "prefix of checkpoint files (default is abl_align)" << endl;
+   cerr << "prefix of the checkpoint file PREFIX.checkpoint (default" << endl;
+   cerr << "                     ";
+   cerr << "is abl_align)" << endl;
 #endif
+   cerr << "  -r, --resume=FILE  ";
+   cerr << "Continue the run that wrote checkpoint FILE (with its" << endl;
+   cerr << "                     ";
+   cerr << "settings and sentences, the input file is not read)" << endl;
    cerr << "  -e, --excl_empty   ";
    cerr << "Do not generate hypotheses that span 0 words" << endl;
    cerr << "  -n, --nomerge      ";
    cerr << "Do not try to merge hypotheses" << endl;
+   cerr << "  -D, --collapse     ";
+   cerr << "Align each distinct sentence once and copy its hypotheses" << endl;
+   cerr << "                     ";
+   cerr << "to the duplicates (wm, wb and aa only)" << endl;
    cerr << "  -d, --debug        ";
    cerr << "Output debug information" << endl;
+   cerr << "  -T, --stats=FILE   ";
+   cerr << "Write the timing of the phases and the counters of the run" << endl;
+   cerr << "                     ";
+   cerr << "to FILE (in JSON)" << endl;
    cerr << "  -h, --help         ";
    cerr << "Show this help and exit" << endl;
    cerr << "  -v, --verbose      ";
@@ -252,22 +480,21 @@ void usage() {
    cerr << "Show version information and exit" << endl;
    cerr << "  -x, --exhaustive   ";
    cerr << "Compare exhaustively each possible sentence pair" << endl;
+   cerr << "  -y, --suffix_array ";
+   cerr << "Find the shared parts with a suffix array, which needs" << endl;
+   cerr << "                     ";
+   cerr << "less memory than the suffix tree (st1, st2, st3 and st4" << endl;
+   cerr << "                     ";
+   cerr << "only)" << endl;
    exit(0);
 }
 
 #if TIMING
+// This procedure only asks for a checkpoint: it is taken at the next safe
+// point of the run (see safe_point), where the treebank is consistent.
 static void alarm_handler(int signal) {
    if (signal == SIGALRM) {
-      stringstream tmpfile;
-      tmpfile << tmp_prefix << "." << tb.current_index();
-      ofstream tmp_out(tmpfile.str().c_str());
-      if (!tmp_out.good()) {
-         warning(program_name, string("couldn't open ")+tmpfile.str());
-      }
-      tb.write_partial(tmp_out);
-      tmp_out.close();
-      debug(program_name, debug_flag, \
-            string("Writing checkpoint: ")+tmpfile.str());
+      checkpoint_due=1;
       alarm(timer);
    }
 }
@@ -276,7 +503,8 @@ static void alarm_handler(int signal) {
 void handle_arguments(int argc, char* argv[]) {
    int opt;
    int option_index;
-   const char* optstring="a:dehi:mo:p:t:vVx";
+   const char* optstring=
+     "a:A:b:B:c:C:dDef:F:hi:j:k:K:l:mM:N:o:p:r:R:S:t:T:u:vVw:xy";
    program_name=argv[0];
    bool input_ok=false,output_ok=false;
    while ((opt=getopt_long_only(argc,argv,optstring,long_options,&option_index))
@@ -319,6 +547,69 @@ void handle_arguments(int argc, char* argv[]) {
                usage();
             }
             break;
+         case 'A':
+            aa_max_alignments=atof(optarg);
+            if (aa_max_alignments < 0) {
+               error(program_name,string("negative number of alignments ")
+                 +optarg);
+            }
+            break;
+         case 'M':
+            aa_max_time=atof(optarg);
+            if (aa_max_time < 0) {
+               error(program_name,string("negative time ")+optarg);
+            }
+            break;
+         case 'K':
+            aa_fallback=atoi(optarg);
+            if (aa_fallback < 0) {
+               error(program_name,string("negative number of alignments ")
+                 +optarg);
+            }
+            break;
+         case 'b':
+            if (base_ifs != 0) {
+               delete base_ifs;
+            }
+            base_ifs=new ifstream(optarg);
+            if (!base_ifs->good()) {
+               error(program_name, string("cannot open base file ")+optarg);
+            }
+            break;
+         case 'B':
+            lsh.bands=atoi(optarg);
+            if (lsh.bands < 1) {
+               error(program_name,string("invalid number of bands ")+optarg);
+            }
+            break;
+         case 'C':
+            if (strcmp(optarg, "index") == 0) {
+               candidate_type=INDEX;
+            } else if (strcmp(optarg, "lsh") == 0) {
+               candidate_type=LSH;
+            } else {
+               error(program_name, "Unknown candidate selection");
+               usage();
+            }
+            break;
+         case 'N':
+            lsh.shingle=atoi(optarg);
+            if (lsh.shingle < 1) {
+               error(program_name,string("invalid shingle size ")+optarg);
+            }
+            break;
+         case 'r':
+            resume_file=optarg;
+            break;
+         case 'T':
+            stats_file=optarg;
+            break;
+         case 'R':
+            lsh.rows=atoi(optarg);
+            if (lsh.rows < 1) {
+               error(program_name,string("invalid number of rows ")+optarg);
+            }
+            break;
          case 'd':
             debug_flag=true;
             break;
@@ -337,8 +628,45 @@ void handle_arguments(int argc, char* argv[]) {
                input_ok=true;
             }
             break;
+         case 'k':
+            max_distance=atof(optarg);
+            if (max_distance < 0) {
+               error(program_name,string("negative maximum distance ")+optarg);
+            }
+            break;
+         case 'f':
+            min_overlap=atoi(optarg);
+            if (min_overlap < 0) {
+               error(program_name,string("negative minimum overlap ")+optarg);
+            }
+            break;
+         case 'F':
+            postings.policy.max_frequency=atof(optarg);
+            if (postings.policy.max_frequency < 0) {
+               error(program_name,string("negative frequency ")+optarg);
+            }
+            break;
+         case 'u':
+            postings.policy.min_shared=atoi(optarg);
+            if (postings.policy.min_shared < 1) {
+               error(program_name,string("invalid number of shared words ")
+                 +optarg);
+            }
+            break;
+         case 'j':
+            threads=atoi(optarg);
+            if (threads < 1) {
+               error(program_name,string("invalid number of threads ")+optarg);
+            }
+            break;
+         case 'l':
+            max_cells=atof(optarg);
+            if (max_cells < 0) {
+               error(program_name,string("negative number of cells ")+optarg);
+            }
+            break;
          case 'n':
-            nomerge_flag=true;
+            hypotheses.nomerge=true;
             break;
          case 'o':
             if (strcmp(optarg, "-") != 0) {
@@ -355,18 +683,24 @@ void handle_arguments(int argc, char* argv[]) {
          case 'p':
             if ((strcmp(optarg, "e") == 0)
               || (strcmp(optarg, "equal") == 0)) {
-               part_type=EQUAL;
+               hypotheses.part_type=EQUAL;
             } else if ((strcmp(optarg, "u") == 0)
                   || (strcmp(optarg, "unequal") == 0)) {
-               part_type=UNEQUAL;
+               hypotheses.part_type=UNEQUAL;
             } else if ((strcmp(optarg, "b") == 0)
                   || (strcmp(optarg, "both") == 0)) {
-               part_type=BOTH;
+               hypotheses.part_type=BOTH;
             } else {
                error(program_name, "Unknown part algorithm");
                usage();
             }
             break;
+         case 'S':
+            if ((sscanf(optarg, "%d/%d", &shard, &shards) != 2)
+              ||(shard < 1)||(shard > shards)) {
+               error(program_name,string("invalid shard ")+optarg);
+            }
+            break;
          case 's':
             seed=atoi(optarg);
             if (!((seed>=0)&&(seed<=9))) {
@@ -376,15 +710,16 @@ void handle_arguments(int argc, char* argv[]) {
 #if TIMING
          case 't':
             timer=atoi(optarg);
-            signal(SIGALRM, alarm_handler);
-            alarm(timer);
             break;
          case 'c':
             tmp_prefix=optarg;
             break;
 #endif
          case 'e':
-            excl_empty=true;
+            hypotheses.excl_empty=true;
+            break;
+         case 'D':
+            collapse_flag=true;
             break;
          case 'v':
             verbose_flag = true;
@@ -393,9 +728,18 @@ void handle_arguments(int argc, char* argv[]) {
             cout << "align (" << PACKAGE << ") version " << VERSION << endl;
             exit(0);
             break;
+         case 'w':
+            band=atoi(optarg);
+            if (band < 0) {
+               error(program_name,string("negative band width ")+optarg);
+            }
+            break;
          case 'x':
             exhaustive_flag=true;
             break;
+         case 'y':
+            suffix_array_flag=true;
+            break;
          case '?': // ambiguous match or extraneous parameter
             usage();
             break;
@@ -404,10 +748,40 @@ void handle_arguments(int argc, char* argv[]) {
             usage();
       }
    }
-   if (align_type == UNDEF) {
+   if (!resume_file.empty() // the settings come from the checkpoint
+     &&((base_ifs != 0)||collapse_flag||(shards > 0))) {
+      error(program_name,
+        "resuming cannot be combined with a base treebank, collapse or shards");
+   }
+   if ((align_type == UNDEF)&&resume_file.empty()) {
       error(program_name, "No alignment type supplied.");
       usage();
    }
+   if ((timer > 0)&&(collapse_flag||(shards > 0))) {
+      error(program_name,
+        "checkpoints cannot be combined with collapse or shards");
+   }
+   if ((shards > 0)&&(align_type != WM)&&(align_type != WB)) {
+      error(program_name, "shards work with wm and wb only");
+   }
+   if ((base_ifs != 0)&&!aligns_pairs()) {
+      error(program_name, "a base treebank works with wm, wb and aa only");
+   }
+   if ((base_ifs != 0)&&(collapse_flag||(shards > 0))) {
+      error(program_name,
+        "a base treebank cannot be combined with collapse or shards");
+   }
+   if (collapse_flag&&(align_type != WM)&&(align_type != WB)
+     &&(align_type != AA)) {
+      warning(program_name, "collapse works with wm, wb and aa only");
+      collapse_flag=false;
+   }
+   if (suffix_array_flag&&(align_type != ST1)&&(align_type != ST2)
+     &&(align_type != ST3)&&(align_type != ST4)) {
+      warning(program_name,
+        "suffix_array works with st1, st2, st3 and st4 only");
+      suffix_array_flag=false;
+   }
    if (optind != argc) {
       warning(program_name, "extraneous argument(s)");
    }
@@ -417,106 +791,716 @@ void read_treebank(Treebank& tb) {
    *ifs >> tb;
 }
 
-Edit_distance_sen *find_alignment(const Sentence& s1, const Sentence& s2) {
+void insert_constituent_raw(Tree* t, const int b, const int e, const int nt) {
+   Constituent c=Constituent(b, e);
+   c.push_back(nt);
+   hypotheses.insert(t,c);
+}
+
+struct Pair_result {
+   // This class holds the outcome of aligning a pair of sentences. In the
+   // all alignments mode these are alignments and parts of the sentences
+   // that are hypotheses (see align_all).
+   enum Budget { WITHIN, OVER_ALIGNMENTS, OVER_TIME };
+   Pair_result() throw():abandoned(false),stream(false),reversed(false),
+     reverse_abandoned(false),cells(0),over(WITHIN) { }
+   bool abandoned;
+   bool stream;            // alignments are found again when applied
+   bool reversed;          // also aligned the other way round (see
+   bool reverse_abandoned; // both_orders)
+   long cells;             // cells of the edit distance matrix computed
+   Alignment alignment;
+   Alignment reverse;      // alignment the other way round
+   vector<Alignment> alignments;
+   vector<Part> parts;
+   Budget over;            // budget that the pair exceeded (aa only)
+};
+
+// This procedure stores the outcome of aligner a in r.
+template <class Aligner>
+void store_result(const Aligner& a, Pair_result& r) {
+   r.abandoned=a.abandoned();
+   r.cells=a.cells();
+   r.alignment.assign(a.align_begin(), a.align_end());
+}
+
+// This procedure finds the hypotheses of all alignments of t1 and t2 and
+// stores them in r. When hypotheses are merged, inserting a pair of
+// hypotheses again changes nothing, so only the distinct parts of the
+// sentences that the alignments give are kept (see All_alignment::parts).
+// Otherwise all alignments are kept, unless there is no budget: their
+// number is not bounded, so they are found again one by one when the pair
+// is applied (see insert_all) instead of being held for the whole window.
+// When the pair exceeds a budget, r holds its fallback alignments instead.
+void align_all(Tree* t1, Tree* t2, Scratch& s, Pair_result& r) {
+   double start=wall_time();
+   All_alignment<Sentence::const_iterator>
+     aa(t1->begin(), t1->end(), t2->begin(), t2->end());
+   r.over=Pair_result::WITHIN;
+   if ((aa_max_alignments > 0)
+     &&(aa.count(aa_max_alignments+1) > aa_max_alignments)) {
+      r.over=Pair_result::OVER_ALIGNMENTS;
+   } else if (!hypotheses.nomerge&&((t1->size() > 0)||(t2->size() > 0))) {
+      if (!aa.parts(hypotheses.part_type != UNEQUAL,
+        hypotheses.part_type != EQUAL, r.parts,
+        (aa_max_time > 0)?start+aa_max_time*1e-6:0)) {
+         r.over=Pair_result::OVER_TIME;
+      }
+   } else if ((aa_max_alignments == 0)&&(aa_max_time == 0)) {
+      r.stream=true;
+   } else {
+      while ((r.over == Pair_result::WITHIN)&&aa.next()) {
+         r.alignments.push_back(Alignment(aa.align_begin(), aa.align_end()));
+         if ((aa_max_time > 0)&&((wall_time()-start)*1e6 > aa_max_time)) {
+            r.over=Pair_result::OVER_TIME;
+         }
+      }
+   }
+   if ((r.over == Pair_result::WITHIN)&&(aa_max_time > 0)
+     &&((wall_time()-start)*1e6 > aa_max_time)) {
+      r.over=Pair_result::OVER_TIME;
+   }
+   if (r.over == Pair_result::WITHIN) {
+      return;
+   }
+   vector<Part>().swap(r.parts);
+   if (aa_fallback > 0) {
+      aa.best(aa_fallback, r.alignments);
+   } else {
+      WF_default<Sentence::const_iterator> a(t1->begin(), t1->end(),
+        t2->begin(), t2->end(), s.dp_buffer, Bounds(-1, -1, max_cells));
+      r.cells=a.cells();
+      r.alignments.assign(1, Alignment(a.align_begin(), a.align_end()));
+   }
+}
+
+// This procedure inserts the hypotheses that align_all stored in r (or,
+// if it streams, of each alignment of t1 and t2 in turn).
+void insert_all(Tree* t1, Tree* t2, const Pair_result& r) {
+   if (r.stream) {
+      All_alignment<Sentence::const_iterator>
+        aa(t1->begin(), t1->end(), t2->begin(), t2->end());
+      while (aa.next()) {
+         hypotheses.insert(t1, t2, aa.align_begin(), aa.align_end());
+      }
+   }
+   for (vector<Alignment>::const_iterator a=r.alignments.begin();
+     a != r.alignments.end(); ++a) {
+      hypotheses.insert(t1, t2, a->begin(), a->end());
+   }
+   for (vector<Part>::const_iterator p=r.parts.begin(); p != r.parts.end();
+     ++p) {
+      Constituent c1=Constituent(p->begin1, p->end1);
+      Constituent c2=Constituent(p->begin2, p->end2);
+      hypotheses.insert(t1, t2, c1, c2);
+   }
+}
+
+// This procedure aligns t1 and t2 with the aligner that fits the alignment
+// type, the bounds and the size of the pair. Pairs with more than
+// max_cells cells are aligned in linear space.
+void align_pair(Tree* t1, Tree* t2, Scratch& s, Pair_result& r) {
+   Bounds bounds(max_distance, band, max_cells);
+   bool fits=(double(t1->size()+1)*(t2->size()+1) <= max_cells);
    switch (align_type) {
    case WM:
-      return new WF_default<Sentence::const_iterator>
-        (s1.begin(), s1.end(), s2.begin(), s2.end());
+      if ((band < 0)&&fits) {
+         BP_default<Sentence::const_iterator>
+           a(t1->begin(), t1->end(), t2->begin(), t2->end(), max_distance);
+         store_result(a, r);
+      } else {
+         WF_default<Sentence::const_iterator> a(t1->begin(), t1->end(),
+           t2->begin(), t2->end(), s.dp_buffer, bounds);
+         store_result(a, r);
+      }
       break;
    case WB:
-      return new WF_biased<Sentence::const_iterator>
-        (s1.begin(), s1.end(), s2.begin(), s2.end());
+      if ((band < 0)&&(max_distance < 0)&&fits&&(simd_lanes() != 0)
+        &&(int(min(t1->size(), t2->size())) >= simd_lanes())) {
+         AD_biased<Sentence::const_iterator> a(t1->begin(), t1->end(),
+           t2->begin(), t2->end(), s.ad_buffer);
+         store_result(a, r);
+      } else {
+         WF_biased<Sentence::const_iterator> a(t1->begin(), t1->end(),
+           t2->begin(), t2->end(), s.dp_buffer, bounds);
+         store_result(a, r);
+      }
+      break;
+   case AA:
+      align_all(t1, t2, s, r);
       break;
    default:
       break;
    }
-   return 0;
 }
 
-void insert_constituent(Tree* t, Constituent& c) {
-   if (!(excl_empty && c.empty()) && c.valid()) {
-      consts_cnt += t->add_structure(c);
-   }
+// Return true if the copies of the sentences of t1 and t2 of the collapsed
+// treebank (t2 later) occur in both orders in the input. Without collapse
+// such pairs are aligned both ways round, and wm and wb may break ties
+// differently each way, so the collapsed pair is aligned both ways too.
+bool both_orders(const Tree* t1, const Tree* t2) {
+   return collapse_flag&&((align_type == WM)||(align_type == WB))
+     &&(first_copy[t2-&tb[0]] < last_copy[t1-&tb[0]]);
 }
 
-void insert_constituent_raw(Tree* t, const int b, const int e, const int nt) {
-   Constituent c=Constituent(b, e);
-   c.push_back(nt);
-   insert_constituent(t,c);
+// Return true if alignment a has hypotheses that may change the treebank.
+// Without a SAME segment the only hypothesis spans both sentences (unequal
+// parts, when merging). The earlier sentence already has the start symbol
+// there, so the later one gets the start symbol too, which its own row
+// adds anyway. Only the first such pair of the later sentence matters: it
+// puts the start symbol earlier among its constituents (see write_event).
+bool changes(const Alignment& a) {
+   for (Alignment::const_iterator s=a.begin(); s != a.end(); ++s) {
+      if (s->kind == ns_edit_distance::SAME) {
+         return true;
+      }
+   }
+   return (hypotheses.part_type == BOTH)
+     ||((hypotheses.part_type == UNEQUAL)&&hypotheses.nomerge);
 }
 
-void insert_constituents(Tree* t1, Tree* t2, Constituent& c1, Constituent& c2) {
-   if (!nomerge_flag) {
-      Tree::struc_iterator c1pos=t1->find_structure(c1);
-      Tree::struc_iterator c2pos=t2->find_structure(c2);
-      if (c1pos != t1->struc_end()) {
-         if (c2pos != t2->struc_end()) { // merge
-            c1.push_back(*c2pos->begin());
-            c2.push_back(*c1pos->begin());
-            insert_constituent(t1,c1);
-            insert_constituent(t2,c2);
-         } else {
-            c2.push_back(*c1pos->begin());
-            insert_constituent(t2,c2);
+// This procedure aligns sentence with the candidates c_b to c_e and stores
+// the outcomes from r onwards. In the wagner_biased mode with vector
+// instructions, candidates of similar length are aligned in batches (see
+// Batch_biased). The longest candidates that would fill less than half a
+// batch, or have more than max_cells cells, are aligned one by one (see
+// align_pair). For the statistics every pair is timed; the pairs of a
+// batch are aligned together, so they share the time of the batch.
+// Pairs that are aligned both ways round (see both_orders) are aligned
+// the other way round afterwards, one by one.
+void align_group(Tree* sentence, Tree* const* c_b, Tree* const* c_e,
+  Pair_result* r, Scratch& s) {
+   bool timed=!stats_file.empty();
+   double start=0;
+   int n=int(c_e-c_b);
+   int batched=0;
+   int lanes=simd_lanes();
+   if ((align_type == WB)&&(band < 0)&&(max_distance < 0)&&(lanes != 0)) {
+      vector<pair<Tree::size_type, int> > order; // (length, candidate)
+      for (int i=0; i<n; i++) {
+         order.push_back(make_pair(c_b[i]->size(), i));
+      }
+      sort(order.begin(), order.end());
+      int fitting=n;
+      while ((fitting > 0)&&(double(sentence->size()+1)
+        *(order[fitting-1].first+1) > max_cells)) {
+         fitting--;
+      }
+      batched=fitting;
+      if (batched%lanes <= lanes/2) {
+         batched-=batched%lanes;
+      }
+      vector<pair<Sentence::const_iterator, Sentence::const_iterator> > others;
+      for (int b=0; b<batched; b+=lanes) {
+         int e=min(batched, b+lanes);
+         others.clear();
+         for (int l=b; l<e; l++) {
+            Tree* t=c_b[order[l].second];
+            others.push_back(make_pair(t->begin(), t->end()));
          }
-      } else {
-         if (c2pos != t2->struc_end()) {
-            c1.push_back(*c2pos->begin());
-            insert_constituent(t1,c1);
-         } else {
-            Nonterminal n=Nonterminal();
-            c1.push_back(n);
-            c2.push_back(n);
-            insert_constituent(t1,c1);
-            insert_constituent(t2,c2);
+         if (timed) {
+            start=wall_time();
+         }
+         Batch_biased<Sentence::const_iterator> a(sentence->begin(),
+           sentence->end(), others, s.batch_buffer);
+         for (int l=b; l<e; l++) {
+            r[order[l].second].alignment=a.alignment(l-b);
+            r[order[l].second].cells=a.cells(l-b);
+         }
+         if (timed) {
+            s.latency.add((wall_time()-start)*1e9/(e-b), e-b);
+         }
+      }
+      for (int i=batched; i<n; i++) {
+         if (timed) {
+            start=wall_time();
+         }
+         align_pair(sentence, c_b[order[i].second], s, r[order[i].second]);
+         if (timed) {
+            s.latency.add((wall_time()-start)*1e9);
          }
       }
    } else {
-      Nonterminal n=Nonterminal();
-      c1.push_back(n);
-      c2.push_back(n);
-      insert_constituent(t1,c1);
-      insert_constituent(t2,c2);
+      for (int i=0; i<n; i++) {
+         if (timed) {
+            start=wall_time();
+         }
+         align_pair(sentence, c_b[i], s, r[i]);
+         if (timed) {
+            s.latency.add((wall_time()-start)*1e9);
+         }
+      }
+   }
+   for (int i=0; i<n; i++) {
+      if (both_orders(sentence, c_b[i])) {
+         Pair_result back;
+         align_pair(c_b[i], sentence, s, back);
+         r[i].reversed=true;
+         r[i].reverse_abandoned=back.abandoned;
+         r[i].reverse.swap(back.alignment);
+         r[i].cells+=back.cells;
+      }
+   }
+}
+
+struct Selection_counts {
+   // This class holds the counters of the selection of candidates (see
+   // Postings, Lsh and Prefilter).
+   long found, frequent_only, too_few_shared, skipped_postings, lsh_found;
+   long considered, skipped;
+   vector<long> removed;  // by each prefilter
+};
+
+// Return the counters of the selection of candidates.
+Selection_counts selection_counts() {
+   Selection_counts c;
+   c.found=postings.policy.found;
+   c.frequent_only=postings.policy.frequent_only;
+   c.too_few_shared=postings.policy.too_few_shared;
+   c.skipped_postings=postings.policy.skipped_postings;
+   c.lsh_found=lsh.found;
+   c.considered=considered_cnt;
+   c.skipped=skipped_cnt;
+   for (Prefilter_chain::const_iterator f=prefilters.begin();
+     f != prefilters.end(); ++f) {
+      c.removed.push_back((*f)->removed);
    }
+   return c;
 }
 
-void handle_ED_alignment(Tree* t1, Tree* t2, Alignment::const_iterator a_b,
-  Alignment::const_iterator a_e) {
-   enum Insert_mode { NONE, SAME, DIFF };
-   Insert_mode current_mode=NONE, next_word=NONE;
-   pair<Tree::size_type, Tree::size_type> begin(0, 0), current(0, 0);
+// This procedure sets the counters of the selection of candidates to c.
+void set_selection_counts(const Selection_counts& c) {
+   postings.policy.found=c.found;
+   postings.policy.frequent_only=c.frequent_only;
+   postings.policy.too_few_shared=c.too_few_shared;
+   postings.policy.skipped_postings=c.skipped_postings;
+   lsh.found=c.lsh_found;
+   considered_cnt=c.considered;
+   skipped_cnt=c.skipped;
+   int i=0;
+   for (Prefilter_chain::const_iterator f=prefilters.begin();
+     (f != prefilters.end())&&(i < int(c.removed.size())); ++f, ++i) {
+      (*f)->removed=c.removed[i];
+   }
+}
 
-   for (Alignment::const_iterator ai=a_b; ai != a_e; ++ai) {
-      if ((dynamic_cast<const sub_dis*>(*ai)|| dynamic_cast<const sub*>(*ai))
-         && (*(t1->begin()+current.first) == *(t2->begin()+current.second))) {
-         next_word=SAME; // match
+void safe_point(const Treebank::size_type row, const int pairs);
+
+struct Row {
+   // This class holds a sentence of a window, the later sentences it is
+   // aligned with (in the order of the treebank), the cost of aligning it
+   // with the first i candidates (cost[i]) and the outcomes. The first
+   // skipped candidates were aligned before the run was resumed and are
+   // left out.
+   Tree* sentence;
+   int skipped;
+   vector<Tree*> candidates;
+   vector<double> cost;
+   vector<Pair_result> results;
+};
+
+struct Tile {
+   // A tile is a block of the upper triangle of sentence pairs: the rows
+   // row_b to row_e-1 of a window with their candidates from column_b up
+   // to (not including) column_e.
+   int row_b, row_e;
+   Tree* column_b;
+   Tree* column_e;
+};
+
+class Window:public Task {
+   // This class aligns the sentences of a range of the treebank (the rows)
+   // with their candidates. The pairs are cut into tiles of tile_size rows
+   // by tile_size columns. Tiles that cost more than a share of the total
+   // (estimated by the number of cells of the edit distance matrices) are
+   // cut into single rows and expensive rows into column ranges. The tiles
+   // are ordered column by column and every thread starts with a stretch
+   // of tiles of about equal cost, so the candidates a thread aligns with
+   // are close to each other in the treebank. Threads that run out of
+   // tiles steal from the others (see Thread_pool).
+public:
+   enum { tile_size=64, max_pairs=65536 };
+
+   Window() throw():first(0),last(0) { }
+
+   // Return true if row i of the treebank is in the window.
+   bool has(const Treebank::size_type i) const throw() {
+      return (i >= first)&&(i < last);
+   }
+
+   // Return the first row of the window.
+   Treebank::size_type first_row() const throw() { return first; }
+
+   // The counters of the selection of candidates before the window was
+   // filled (kept with a checkpoint, see safe_point).
+   Selection_counts counts;
+
+   // This procedure selects the candidates of the sentences from i onwards
+   // until the window holds max_pairs pairs (or the treebank ends) and
+   // aligns all of them.
+   void fill(Treebank& tb, const Treebank::size_type i) {
+      rows.clear();
+      tiles.clear();
+      counts=selection_counts();
+      first=last=i;
+      int pairs=0;
+      while ((last < tb.size())&&((last == first)||(pairs < max_pairs))) {
+         rows.push_back(Row());
+         select_candidates(tb, last, rows.back());
+         pairs+=rows.back().candidates.size();
+         last++;
+      }
+      make_tiles(tb);
+      double share=budget*tiles_per_thread;
+      vector<int> starts;
+      starts.push_back(0);
+      double done=0;
+      for (int t=0; t<int(tiles.size()); t++) {
+         done+=cost(tiles[t]);
+         while ((int(starts.size()) < pool->size())
+           &&(done >= double(starts.size())*share)) {
+            starts.push_back(t+1);
+         }
+      }
+      while (int(starts.size()) <= pool->size()) {
+         starts.push_back(tiles.size());
+      }
+      pool->run(*this, starts);
+   }
+
+   // This procedure handles the alignments of row i of the treebank in the
+   // order of the candidates, so the hypotheses do not depend on the tiles
+   // or the number of threads. The alignments of a shard are written to
+   // the output instead (see Event). Every pair is a safe point for a
+   // checkpoint. The row is freed afterwards.
+   void apply(const Treebank::size_type i) {
+      Row& row=rows[i-first];
+      for (int c=0; c<int(row.candidates.size()); c++) {
+         const Pair_result& r=row.results[c];
+         aligned_cnt++;
+         cells_cnt+=r.cells;
+         if (r.over == Pair_result::OVER_ALIGNMENTS) {
+            over_alignments_cnt++;
+         } else if (r.over == Pair_result::OVER_TIME) {
+            over_time_cnt++;
+         }
+         if (r.abandoned) {
+            abandoned_cnt++;
+         } else if (align_type == AA) {
+            insert_all(row.sentence, row.candidates[c], r);
+         } else if (shards > 0) {
+            write_event(i, i+(row.candidates[c]-row.sentence), false,
+              r.alignment);
+         } else {
+            hypotheses.insert(row.sentence, row.candidates[c],
+              r.alignment.begin(), r.alignment.end());
+         }
+         if (r.reversed) {
+            if (r.reverse_abandoned) {
+               abandoned_cnt++;
+            } else if (shards > 0) {
+               write_event(i, i+(row.candidates[c]-row.sentence), true,
+                 r.reverse);
+            } else {
+               hypotheses.insert(row.candidates[c], row.sentence,
+                 r.reverse.begin(), r.reverse.end());
+            }
+         }
+         safe_point(i, row.skipped+c+1);
+      }
+      vector<Tree*>().swap(row.candidates);
+      vector<double>().swap(row.cost);
+      vector<Pair_result>().swap(row.results);
+   }
+
+   // This procedure writes the alignment of sentence i with the later
+   // sentence j (of j with i if reversed) to the shard, unless it changes
+   // nothing.
+   void write_event(const int i, const int j, const bool reversed,
+     const Alignment& a) {
+      if (!changes(a)) {
+         if ((hypotheses.part_type != UNEQUAL)||spanned[j]) {
+            left_out_cnt++;
+            return;
+         }
+         spanned[j]=true;
+      }
+      Event e;
+      e.first=i;
+      e.second=j;
+      e.reversed=reversed;
+      e.alignment=a;
+      events->write(e);
+   }
+
+   void run(const int job, const int thread) {
+      const Tile& t=tiles[job];
+      for (int i=t.row_b; i<t.row_e; i++) {
+         Row& row=rows[i];
+         int b=column(row, t.column_b), e=column(row, t.column_e);
+         if (b == e) {
+            continue;
+         }
+         align_group(row.sentence, &row.candidates[0]+b,
+           &row.candidates[0]+e, &row.results[0]+b, scratch[thread]);
+      }
+   }
+
+private:
+   enum { tiles_per_thread=16 };
+
+   // Return true if the pair of sentences i and j (positions in the
+   // treebank) belongs to the shard. The pairs are divided in blocks of
+   // tile_size by tile_size sentences, which are spread over the shards
+   // by a hash.
+   bool in_shard(const int i, const int j) const throw() {
+      uint64_t block=(uint64_t(i/tile_size) << 32)|uint64_t(j/tile_size);
+      return (shards == 0)||(int(ns_minhash::mix(block)%shards) == shard-1);
+   }
+
+   // This procedure selects the later sentences that sentence i of the
+   // treebank is aligned with: all of them (exhaustive) or those that
+   // have a word in common with it (see Postings), if the prefilters let
+   // them pass. Sentences of the base treebank are left out, and so are
+   // the pairs that were aligned before the run was resumed.
+   void select_candidates(Treebank& tb, const Treebank::size_type i,
+     Row& row) {
+      Treebank::iterator current=tb.begin()+i;
+      row.sentence=(Tree*)&*current;
+      if (exhaustive_flag) {
+         later.clear();
+         for (int j=max(i+1, first_new); j<int(tb.size()); j++) {
+            later.push_back(j);
+         }
+      } else if (candidate_type == LSH) {
+         lsh.later(i, later, first_new);
       } else {
-         next_word=DIFF;
-      }
-      if (current_mode == NONE) {
-         current_mode=next_word;
-      }
-      if (current_mode != next_word) { // handle hypothesis
-         Constituent c1=Constituent(begin.first, current.first);
-         Constituent c2=Constituent(begin.second, current.second);
-         if (((part_type == BOTH)||(part_type==EQUAL))&&(current_mode==SAME)) {
-            insert_constituents(t1, t2, c1, c2);
-         } else if (((part_type == BOTH)||(part_type == UNEQUAL))
-               &&(current_mode == DIFF)) {
-            insert_constituents(t1, t2, c1, c2);
+         postings.later(i, *current, later, first_new);
+      }
+      row.cost.push_back(0);
+      row.skipped=0;
+      int skip=(i < resume_row)?int(later.size()):(i == resume_row)?resume_pairs:0;
+      considered_cnt+=later.size();
+      for (vector<int>::const_iterator j=later.begin(); j != later.end();
+        ++j) {
+         if (!in_shard(i, *j)) {
+            skipped_cnt++;
+            continue;
+         }
+         if (!prefilters.empty()
+           && !prefilters.pass(Pair_summary(bags[i], bags[*j]))) {
+            skipped_cnt++;
+            continue;
+         }
+         if (row.skipped < skip) {
+            row.skipped++;
+            continue;
+         }
+         Tree* t=&tb[*j];
+         row.candidates.push_back(t);
+         row.cost.push_back(row.cost.back()
+           +double(current->size()+1)*(t->size()+1));
+      }
+      row.results.resize(row.candidates.size());
+   }
+
+   // Return the position of the first candidate of row that is not before
+   // sentence c.
+   int column(const Row& row, Tree* c) const throw() {
+      return lower_bound(row.candidates.begin(), row.candidates.end(), c)
+        -row.candidates.begin();
+   }
+
+   // Return the estimated cost of tile t.
+   double cost(const Tile& t) const throw() {
+      double c=0;
+      for (int i=t.row_b; i<t.row_e; i++) {
+         const Row& row=rows[i];
+         c+=row.cost[column(row, t.column_e)]
+           -row.cost[column(row, t.column_b)];
+      }
+      return c;
+   }
+
+   // This procedure cuts the pairs of the window into tiles.
+   void make_tiles(Treebank& tb) {
+      double total=0;
+      for (int i=0; i<int(rows.size()); i++) {
+         total+=rows[i].cost.back();
+      }
+      budget=total/(double(pool->size())*tiles_per_thread);
+      Tree* base=(Tree*)&*tb.begin();
+      for (Treebank::size_type cb=max(first+1, first_new); cb<tb.size();
+        cb+=tile_size) {
+         Tree* column_b=base+cb;
+         Tree* column_e=base+min(tb.size(), cb+tile_size);
+         for (int rb=0; (rb < int(rows.size()))&&(first+rb < cb+tile_size);
+           rb+=tile_size) {
+            Tile t={rb, min(int(rows.size()), rb+tile_size),
+              column_b, column_e};
+            double c=cost(t);
+            if (c == 0) {
+               continue;
+            }
+            if (c <= budget) {
+               tiles.push_back(t);
+               continue;
+            }
+            for (int i=t.row_b; i<t.row_e; i++) {
+               split_row(i, column_b, column_e);
+            }
          }
-         begin=current;
-         current_mode=next_word;
       }
-      current=(*ai)->next_coord(current);
    }
-   // Handle hypotheses at the end of the sentence
-   if ((part_type == BOTH)||((part_type == EQUAL)&&(current_mode == SAME))
-         ||((part_type == UNEQUAL)&&(current_mode == DIFF))) {
-      Constituent c1=Constituent(begin.first, t1->size());
-      Constituent c2=Constituent(begin.second, t2->size());
-      insert_constituents(t1, t2, c1, c2);
+
+   // This procedure adds the candidates of row i from column_b up to
+   // column_e as tiles that cost at most the budget (unless a single
+   // pair costs more).
+   void split_row(const int i, Tree* column_b, Tree* column_e) {
+      const Row& row=rows[i];
+      int b=column(row, column_b), e=column(row, column_e);
+      while (b < e) {
+         int m=b+1;
+         while ((m < e)&&(row.cost[m+1]-row.cost[b] <= budget)) {
+            m++;
+         }
+         Tile t={i, i+1, row.candidates[b],
+           (m < e)?row.candidates[m]:column_e};
+         tiles.push_back(t);
+         b=m;
+      }
    }
+
+   Treebank::size_type first, last; // the rows of the treebank
+   vector<Row> rows;
+   vector<int> later;               // scratch space of select_candidates
+   vector<Tile> tiles;
+   double budget;                   // cost of a tile that is cut
+};
+
+// The sentences that are being aligned (wm, wb and aa only)
+Window window;
+
+// This procedure puts the settings that decide the outcome of the run in
+// a (or gets them from a when restore is true).
+template <class T>
+void transfer(Archive& a, T& x, const bool restore) {
+   if (restore) {
+      a.get(x);
+   } else {
+      a.put(x);
+   }
+}
+
+void transfer_settings(Archive& a, const bool restore) {
+   transfer(a, align_type, restore);
+   transfer(a, hypotheses.part_type, restore);
+   transfer(a, hypotheses.nomerge, restore);
+   transfer(a, hypotheses.excl_empty, restore);
+   transfer(a, exhaustive_flag, restore);
+   transfer(a, max_distance, restore);
+   transfer(a, band, restore);
+   transfer(a, max_cells, restore);
+   transfer(a, min_overlap, restore);
+   transfer(a, postings.policy.max_frequency, restore);
+   transfer(a, postings.policy.min_shared, restore);
+   transfer(a, candidate_type, restore);
+   transfer(a, lsh.bands, restore);
+   transfer(a, lsh.rows, restore);
+   transfer(a, lsh.shingle, restore);
+   transfer(a, first_new, restore);
+   transfer(a, aa_max_alignments, restore);
+   transfer(a, aa_max_time, restore);
+   transfer(a, aa_fallback, restore);
+}
+
+// The counters of the selection of candidates of a resumed run (restored
+// when the prefilters are made, see find_structure)
+Selection_counts resume_counts;
+
+// This procedure takes a checkpoint if the alarm asked for one. It is
+// called at safe points: the alignments of the rows before row and of
+// the first pairs pairs of row are in the treebank and the others are
+// not. A resumed run does not take checkpoints before it has caught up.
+// The state is put in an archive, which is written in the background.
+void safe_point(const Treebank::size_type row, const int pairs) {
+   if (!checkpoint_due||(checkpoints == 0)||checkpoints->busy()
+     ||(row < resume_row)||((row == resume_row)&&(pairs < resume_pairs))) {
+      return;
+   }
+   checkpoint_due=0;
+   // A window selects the candidates of all its rows first, so the run
+   // resumes from the start of the window with its counters.
+   Treebank::size_type from=window.has(row)?window.first_row():row;
+   const Selection_counts c=window.has(row)?window.counts:selection_counts();
+   Archive a;
+   transfer_settings(a, false);
+   a.put(hypotheses.count);
+   a.put(hypotheses.merged);
+   a.put(abandoned_cnt);
+   a.put(aligned_cnt);
+   a.put(cells_cnt);
+   a.put(over_alignments_cnt);
+   a.put(over_time_cnt);
+   a.put(c.found);
+   a.put(c.frequent_only);
+   a.put(c.too_few_shared);
+   a.put(c.skipped_postings);
+   a.put(c.lsh_found);
+   a.put(c.considered);
+   a.put(c.skipped);
+   a.put(int(c.removed.size()));
+   for (int i=0; i<int(c.removed.size()); i++) {
+      a.put(c.removed[i]);
+   }
+   a.put(from);
+   a.put(row);
+   a.put(pairs);
+   a.put(tb);
+   checkpoints->write(a);
+   stringstream where;
+   where << "Writing checkpoint at sentence " << row << ", pair " << pairs;
+   debug(program_name, debug_flag, where.str());
+}
+
+// This procedure restores the run that wrote the checkpoint file name.
+void resume(const string& name) {
+   Archive a;
+   if (!a.read(name)) {
+      error(program_name, string("cannot read checkpoint ")+name);
+   }
+   transfer_settings(a, true);
+   a.get(hypotheses.count);
+   a.get(hypotheses.merged);
+   a.get(abandoned_cnt);
+   a.get(aligned_cnt);
+   a.get(cells_cnt);
+   a.get(over_alignments_cnt);
+   a.get(over_time_cnt);
+   a.get(resume_counts.found);
+   a.get(resume_counts.frequent_only);
+   a.get(resume_counts.too_few_shared);
+   a.get(resume_counts.skipped_postings);
+   a.get(resume_counts.lsh_found);
+   a.get(resume_counts.considered);
+   a.get(resume_counts.skipped);
+   int n=0;
+   a.get(n);
+   for (int i=0; a.good&&(i<n); i++) {
+      long removed=0;
+      a.get(removed);
+      resume_counts.removed.push_back(removed);
+   }
+   Treebank::size_type from=0;
+   a.get(from);
+   a.get(resume_row);
+   a.get(resume_pairs);
+   a.get(tb);
+   if (!a.good||(a.pos != a.data.size())||(from > resume_row)
+     ||(resume_row > tb.size())) {
+      error(program_name, string("damaged checkpoint ")+name);
+   }
+   tb.set_current_index(from);
 }
 
 void handle_ED_structure(Treebank& tb, Treebank::iterator& current) {
@@ -539,46 +1523,23 @@ void handle_ED_structure(Treebank& tb, Treebank::iterator& current) {
          c.push_back(n);
          current->add_structure(c);
       }
-   } else if (align_type == AA) { // all alignments
-      Treebank::iterator new_pos=current;
-      ++new_pos;
-      for(Treebank::iterator t=new_pos;t != tb.end();++t) {
-         All_alignment<Sentence::const_iterator>
-           aa(current->begin(), current->end(), t->begin(), t->end());
-         for (vector<Alignment>::const_iterator a=aa.align_begin();
-           a != aa.align_end(); ++a) {
-            handle_ED_alignment((Tree*)&*current, (Tree*)&*t, a->begin(), a->end());
-         }
-      }
-   } else {
-      Treebank::iterator new_pos=current;
-      ++new_pos;
-      for(Treebank::iterator t=new_pos;t != tb.end();++t) {
-         bool do_align=true;
-
-         if (!exhaustive_flag && !current->isSimilarTo(t->getID())) {
-            do_align=false;
-         }
-
-         if (do_align) {
-            Edit_distance_sen *a=find_alignment(*current, *t);
-            handle_ED_alignment((Tree*)&*current, (Tree*)&*t, a->align_begin(), a->align_end());
-            delete a;
-         }
-      }
    }
 }
 
 void handle_ST_structure(  Treebank& tb, Treebank::iterator current,
-                           Suffixtree& st) {
+                           Suffix_index& st) {
    int i = tb.current_index();
    st.construct(i);
 }
 
 void find_structure(Treebank& tb) {
    // declare St objects in the case of methods ST*
-   Suffixtree st(tb);
-   Suffixtree pt(tb);
+   Suffixtree st_tree(tb);
+   Suffixtree pt_tree(tb);
+   Suffixarray st_array(tb);
+   Suffixarray pt_array(tb);
+   Suffix_index& st=suffix_array_flag?(Suffix_index&)st_array:st_tree;
+   Suffix_index& pt=suffix_array_flag?(Suffix_index&)pt_array:pt_tree;
    st.fix = 0;
    pt.fix = 1;
 
@@ -589,6 +1550,36 @@ void find_structure(Treebank& tb) {
 
    Nonterminal start(startsymbol);
    debug(program_name, debug_flag, "Finding structure");
+   stats.begin("index");
+
+   if (((align_type == WM)||(align_type == WB))&&(max_distance >= 0)) {
+      prefilters.add(new Length_filter(max_distance));
+      prefilters.add(new Bag_filter(max_distance));
+   }
+   if (aligns_pairs()&&(min_overlap > 0)) {
+      prefilters.add(new Overlap_filter(min_overlap));
+   }
+   if (aligns_pairs()&&!exhaustive_flag) {
+      if (candidate_type == LSH) {
+         lsh.build(tb.begin(), tb.end(), *pool);
+      } else {
+         postings.policy.count_frequent=verbose_flag||!stats_file.empty();
+         postings.build(tb.begin(), tb.end());
+      }
+   }
+   if (!prefilters.empty()) {
+      bags.resize(tb.size());
+      for (Treebank::size_type i=0; i<tb.size(); i++) {
+         for (Tree::const_iterator w=tb[i].begin(); w != tb[i].end(); ++w) {
+            bags[i].push_back(w->getIdx());
+         }
+         sort(bags[i].begin(), bags[i].end());
+      }
+   }
+   if (!resume_file.empty()) {
+      set_selection_counts(resume_counts);
+   }
+   stats.begin("align");
 
    for(;tb.current_index()<tb.size();tb.inc_current_index()) {
       Treebank::iterator s=tb.begin()+tb.current_index();
@@ -599,16 +1590,21 @@ void find_structure(Treebank& tb) {
          // suffix tree alignment
          handle_ST_structure(tb, s, st);
       } else {
+         safe_point(tb.current_index(), 0);
          // start symbol
          Constituent c=Constituent(0, s->size());
          c.push_back(start);
-         consts_cnt += s->add_structure(c);
+         hypotheses.count += s->add_structure(c);
 
-         // edit distance alignment
-         if (!exhaustive_flag) {
-            s->getSimilars();
+         if (aligns_pairs()) {
+            // edit distance alignment
+            if (!window.has(tb.current_index())) {
+               window.fill(tb, tb.current_index());
+            }
+            window.apply(tb.current_index());
+         } else {
+            handle_ED_structure(tb, s);
          }
-         handle_ED_structure(tb, s);
      }
    }
 
@@ -701,6 +1697,9 @@ void outit() {
    if (ofs != &cout) {
       delete ofs;
    }
+   if (base_ifs != 0) {
+      delete base_ifs;
+   }
 }
 
 void write_infoheader(const Treebank& tb, char** args, int& argsc, int& c) {
@@ -726,24 +1725,221 @@ void write_infoheader(const Treebank& tb, char** args, int& argsc, int& c) {
    }
 }
 
+// This procedure writes the statistics of the run to the stats file.
+void write_stats(const Treebank& tb, int argc, char* argv[]) {
+   stats.end();
+   stats.set("sentences", tb.size());
+   if (base_ifs != 0) {
+      stats.set("base_sentences", first_new);
+   }
+   stats.set("pairs_considered", considered_cnt);
+   stats.set("pairs_skipped", skipped_cnt);
+   stats.set("pairs_aligned", aligned_cnt);
+   stats.set("pairs_abandoned", abandoned_cnt);
+   if (shards > 0) {
+      stats.set("pairs_left_out", left_out_cnt);
+   }
+   stats.set("cells_computed", cells_cnt);
+   if (aligns_pairs()&&!exhaustive_flag) {
+      stats.set("candidates_in_frequent_postings",
+        postings.policy.skipped_postings);
+      if (postings.policy.count_frequent) {
+         stats.set("pairs_dropped_max_frequency",
+           postings.policy.frequent_only);
+      }
+      stats.set("pairs_dropped_min_shared", postings.policy.too_few_shared);
+   }
+   for (Prefilter_chain::const_iterator f=prefilters.begin();
+     f != prefilters.end(); ++f) {
+      string name="rejected_"+(*f)->name;
+      replace(name.begin(), name.end(), ' ', '_');
+      stats.set(name, (*f)->removed);
+   }
+   if (align_type == AA) {
+      stats.set("pairs_over_alignment_budget", over_alignments_cnt);
+      stats.set("pairs_over_time_budget", over_time_cnt);
+   }
+   stats.set("hypotheses_inserted", hypotheses.count);
+   stats.set("hypotheses_merged", hypotheses.merged);
+   if (checkpoints != 0) {
+      stats.set("checkpoints_written", checkpoints->written);
+   }
+   Histogram& lengths=stats.histogram("sentence_length");
+   for (Treebank::const_iterator t=tb.begin(); t != tb.end(); ++t) {
+      lengths.add(t->size());
+   }
+   Histogram& latency=stats.histogram("pair_latency_ns");
+   for (vector<Scratch>::const_iterator s=scratch.begin(); s != scratch.end();
+     ++s) {
+      latency.add(s->latency);
+   }
+   if (!stats.write(stats_file, program_name, argc, argv)) {
+      warning(program_name, "cannot write statistics to "+stats_file);
+   }
+}
+
 int main(int argc, char* argv[]) {
    const clock_t startTime = clock();
    handle_arguments(argc, argv);
-   tb.setExhaustive(exhaustive_flag);
-   read_treebank(tb);
+   stats.begin("read");
+   if (!resume_file.empty()) {
+      resume(resume_file);
+   } else {
+      tb.setExhaustive(exhaustive_flag);
+      if (base_ifs != 0) {
+         *base_ifs >> tb;
+         first_new=tb.size();
+      }
+      read_treebank(tb);
+   }
+   if ((timer > 0)&&(align_type != WM)&&(align_type != WB)
+     &&(align_type != AA)) {
+      warning(program_name, "checkpoints work with wm, wb and aa only");
+      timer=0;
+   }
+#if TIMING
+   if (timer > 0) {
+      checkpoints=new Checkpoint_writer(tmp_prefix+".checkpoint");
+      signal(SIGALRM, alarm_handler);
+      alarm(timer);
+   }
+#endif
    if (verbose_flag) {
+      if (!resume_file.empty()) {
+         cerr << program_name << "  : # resumed at sentence         : "
+            << resume_row << endl;
+      }
+      if (base_ifs != 0) {
+         cerr << program_name << "  : # sentences in base treebank  : "
+            << first_new << endl;
+      }
       cerr << program_name << "  : # sentences loaded            : "
-         << tb.size() << endl;
+         << tb.size()-first_new << endl;
+   }
+   Treebank all;         // all trees while the treebank is collapsed
+   vector<int> copies;   // distinct sentence of every tree
+   if (collapse_flag) {
+      tb.collapse(all, copies);
+      first_copy.assign(tb.size(), int(all.size()));
+      last_copy.assign(tb.size(), 0);
+      for (int i=0; i<int(all.size()); i++) {
+         first_copy[copies[i]]=min(first_copy[copies[i]], i);
+         last_copy[copies[i]]=i;
+      }
+      if (verbose_flag) {
+         cerr << program_name << "  : # distinct sentences          : "
+            << tb.size() << endl;
+      }
+   }
+   simd_lanes(); // detect the instruction set before threads start
+   Thread_pool thread_pool(threads);
+   pool=&thread_pool;
+   scratch.resize(thread_pool.size());
+   if (shards > 0) {
+      Shard_header h;
+      h.shard=shard;
+      h.shards=shards;
+      h.sentences=tb.size();
+      h.part_type=hypotheses.part_type;
+      h.nomerge=hypotheses.nomerge;
+      h.excl_empty=hypotheses.excl_empty;
+      h.collapse=collapse_flag;
+      h.align=(align_type == WM)?"wm":"wb";
+      h.exhaustive=exhaustive_flag;
+      h.max_distance=max_distance;
+      h.band=band;
+      h.max_frequency=postings.policy.max_frequency;
+      h.min_shared=postings.policy.min_shared;
+      h.min_overlap=min_overlap;
+      h.candidates=(candidate_type == LSH)?'l':'i';
+      h.lsh_bands=lsh.bands;
+      h.lsh_rows=lsh.rows;
+      h.lsh_shingle=lsh.shingle;
+      h.fingerprint=fingerprint(tb.begin(), tb.end());
+      h.write(*ofs);
+      events=new Event_writer(*ofs);
+      spanned.assign(tb.size(), false);
    }
    find_structure(tb);
-   write_infoheader(tb, argv, argc, consts_cnt);
-   write_treebank(tb);
+   if (shards > 0) {
+      events->finish(abandoned_cnt, left_out_cnt);
+      delete events;
+   }
+   stats.begin("write");
+   if (checkpoints != 0) {
+#if TIMING
+      alarm(0);
+#endif
+      checkpoints->wait();
+      if (checkpoints->failed > 0) {
+         warning(program_name, "could not write checkpoint "+tmp_prefix
+           +".checkpoint");
+      }
+   }
+   if (collapse_flag) {
+      tb.expand(all, copies);
+   }
+   if (shards == 0) {
+      write_infoheader(tb, argv, argc, hypotheses.count);
+      write_treebank(tb);
+   }
    outit();
    if (verbose_flag) {
       cerr << program_name << "  : # hypotheses generated        : "
-         << consts_cnt << endl;
+         << hypotheses.count << endl;
+      if ((max_distance >= 0)&&((align_type == WM)||(align_type == WB))) {
+         cerr << program_name << "  : # sentence pairs abandoned    : "
+            << abandoned_cnt << endl;
+      }
+      if (aligns_pairs()&&!exhaustive_flag&&(candidate_type == LSH)) {
+         cerr << program_name << "  : # candidate pairs             : "
+            << lsh.found << endl;
+         cerr << program_name << "  : # similarity threshold        : "
+            << lsh.threshold() << endl;
+         for (int j=1; j<4; j++) {
+            stringstream label;
+            label << "# estimated recall, J=" << j/4.0;
+            cerr << program_name << "  : " << setiosflags(ios::left)
+               << setw(30) << label.str() << ": " << lsh.recall(j/4.0) << endl;
+         }
+      } else if (aligns_pairs()&&!exhaustive_flag) {
+         const Candidate_policy& p=postings.policy;
+         cerr << program_name << "  : # candidate pairs             : "
+            << p.found-p.too_few_shared << endl;
+         if (p.frequent_words > 0) {
+            cerr << program_name << "  : # ignored frequent words      : "
+               << p.frequent_words << endl;
+            cerr << program_name << "  : # skipped, frequent postings  : "
+               << p.skipped_postings << endl;
+            cerr << program_name << "  : # dropped, only frequent words: "
+               << p.frequent_only << endl;
+         }
+         if (p.min_shared > 1) {
+            cerr << program_name << "  : # rejected, shared words      : "
+               << p.too_few_shared << endl;
+         }
+      }
+      if ((align_type == AA)&&((aa_max_alignments > 0)||(aa_max_time > 0))) {
+         cerr << program_name << "  : # pairs over alignment budget : "
+            << over_alignments_cnt << endl;
+         cerr << program_name << "  : # pairs over time budget      : "
+            << over_time_cnt << endl;
+      }
+      for (Prefilter_chain::const_iterator f=prefilters.begin();
+        f != prefilters.end(); ++f) {
+         cerr << program_name << "  : " << setiosflags(ios::left) << setw(30)
+            << "# rejected, "+(*f)->name << ": " << (*f)->removed << endl;
+      }
+      if (checkpoints != 0) {
+         cerr << program_name << "  : # checkpoints written         : "
+            << checkpoints->written << endl;
+      }
       cerr << program_name << "  : # seconds execution time      : "
          << (double)(clock()-startTime)/CLOCKS_PER_SEC << endl;
    }
+   if (!stats_file.empty()) {
+      write_stats(tb, argc, argv);
+   }
+   delete checkpoints;
    return 0;
 }
@@ -20,10 +20,11 @@
 
 #include <algorithm>
 #include <set>
+#include <utility>
 #include <vector>
 #include "edit_distance.h"
 #include "sentence.h"
-#include "tools.h"
+#include "stats.h"
 #include "tree.h"
 
 using ns_sentence::Sentence;
@@ -32,173 +33,291 @@ using ns_tree::Tree;
 namespace ns_edit_distance {
 
 typedef pair<int, int> Link;
-typedef vector<Link> Linklist; 
-typedef set<Linklist> Setlinklist; 
 
-template <class E>
-class In {
-public:
-   In(const vector<E>& e):elem(e) { }
-   bool operator() (const E &e) const {
-      return find(elem.begin(), elem.end(), e) != elem.end();
-   }
-private:
-   vector<E> elem;
-};
-
-class Overlap {
-public:
-   Overlap(const Link& l):link(l) { }
-   bool operator() (const Link& e) const {
-      return (((e.first<=link.first)&&(e.second>=link.second))
-        ||((e.first>=link.first)&&(e.second<=link.second)));
-   }
-private:
-   Link link;
-};
-
-class Subset {
-public:
-   Subset(const Linklist& l):link(l) { }
-   bool operator() (const Linklist& e) const {
-      return includes(e.begin(), e.end(), link.begin(), link.end());
-   }
-private:
-   Linklist link;
+struct Part {
+   // This class describes the parts of two sentences that a segment of an
+   // alignment covers: words begin1 up to end1 of the first and begin2 up
+   // to end2 of the second sentence.
+   Part(const int b1, const int e1, const int b2, const int e2) throw()
+     :begin1(b1),end1(e1),begin2(b2),end2(e2) { }
+   int begin1, end1;
+   int begin2, end2;
 };
 
 template <class Ran>
 class All_alignment {
+   // This class enumerates the alignments of two sentences that link a
+   // maximal set of non-crossing pairs of equal words, one at a time. The
+   // pairs of equal words form a graph in which a link leads to the links
+   // that may directly follow it: those further on in both sentences with
+   // no pair of equal words in between. Every path through the graph from
+   // a link without predecessor to one without successor is such a set,
+   // so the paths are walked depth first, which gives the alignments in
+   // lexicographic order of their links. Only the current path is kept.
 public:
    All_alignment(Ran b1, Ran e1, Ran b2, Ran e2) throw()
-     :begin1(b1),end1(e1),begin2(b2),end2(e2) {
-      operations.push_back(new Ins<Ran>(b1, e1, b2, e2));
-      operations.push_back(new Del<Ran>(b1, e1, b2, e2));
-      operations.push_back(new Sub<Ran>(b1, e1, b2, e2));
-
-      Setlinklist all=find_all_links();
-      for (Setlinklist::const_iterator i=all.begin(); i != all.end(); i++) {
-         int current_i=0, current_j=0;
-         Ran ran_i=b1, ran_j=b2;
-         Alignment new_alignment;
-         for (Linklist::const_iterator ai=i->begin(); ai != i->end(); ai++) {
-            while (current_i != ai->first) {
-               new_alignment.push_back(operations[0]);
-               current_i++; ran_i++;
-            }
-            while (current_j != ai->second) {
-               new_alignment.push_back(operations[1]);
-               current_j++; ran_j++;
+     :len1(e1-b1),len2(e2-b2),matches(e1-b1),started(false) {
+      int i=0;
+      for (Ran i_i=b1; i_i != e1; i_i++,i++) {
+         int j=0;
+         for (Ran j_i=b2; j_i != e2; j_i++,j++) {
+            if (*i_i == *j_i) {
+               matches[i].push_back(j);
             }
-            new_alignment.push_back(operations[2]);
-            current_i++; current_j++;
-            ran_i++; ran_j++;
-         }
-         while (ran_i != e1) {
-            new_alignment.push_back(operations[0]);
-            ran_i++;
-         }
-         while (ran_j != e2) {
-            new_alignment.push_back(operations[1]);
-            ran_j++;
          }
-         alignments.push_back(new_alignment);
       }
    }
 
-   ~All_alignment() {
-      for (vector<Edit_operation*>::iterator i=operations.begin();
-      i != operations.end(); i++) {
-         delete *i;
+   // This procedure moves to the next alignment (the first one when it is
+   // called for the first time). It returns false if there is none left.
+   bool next() throw() {
+      if (started) {
+         do {
+            if (path.empty()) {
+               return false;
+            }
+            Link last=path.back();
+            path.pop_back();
+            successors(path.empty()?start:path.back(), last, found, false);
+            if (!found.empty()) {
+               path.push_back(found[0]);
+               break;
+            }
+         } while (true);
       }
+      started=true;
+      do {
+         successors(path.empty()?start:path.back(), start, found, false);
+         path.insert(path.end(), found.begin(), found.end());
+      } while (!found.empty());
+      build(path, alignment);
+      return true;
    }
 
-   // Return an iterator to the begin of the alignment of the two
-   // sentences.
-   vector<Alignment>::const_iterator
-   align_begin() const throw() { return alignments.begin(); }
+   // Return an iterator to the begin of the current alignment.
+   Alignment::const_iterator
+   align_begin() const throw() { return alignment.begin(); }
+
+   // Return an iterator to the end of the current alignment.
+   Alignment::const_iterator
+   align_end() const throw() { return alignment.end(); }
 
-   // Return an iterator to the end of the alignment of the two
-   // sentences.
-   vector<Alignment>::const_iterator
-   align_end() const throw() { return alignments.end(); }
+   // Return the number of alignments, or limit if there are more. The
+   // paths are counted from the end of the sentences backwards, so no
+   // alignment is built.
+   double count(const double limit) const {
+      vector<Link> nodes, next_nodes;
+      vector<int> offsets;
+      graph(nodes, offsets);
+      vector<double> paths(nodes.size());
+      for (int v=int(nodes.size())-1; v >= -1; v--) {
+         successors((v < 0)?start:nodes[v], start, next_nodes, true);
+         double n=next_nodes.empty()?1:0;
+         for (vector<Link>::const_iterator l=next_nodes.begin();
+           l != next_nodes.end(); ++l) {
+            n=min(limit, n+paths[node(*l, offsets)]);
+         }
+         if (v < 0) {
+            return n;
+         }
+         paths[v]=n;
+      }
+      return 0; // not reached
+   }
 
-   // Return an riterator to the begin of the alignment
-   // of the two sentences.
-   vector<Alignment>::const_reverse_iterator
-   align_rbegin() const throw() { return alignments.rbegin(); }
+   // This procedure puts the k alignments with the most links in result,
+   // best first. They have the lowest edit cost with the default gamma
+   // (every word that is not linked costs 1). Alignments with the same
+   // number of links are in lexicographic order.
+   void best(const int k, vector<Alignment>& result) const {
+      vector<Link> nodes, next_nodes;
+      vector<int> offsets;
+      graph(nodes, offsets);
+      // the k longest paths from every link: the number of links, the
+      // next link and the rank of the rest of the path among its paths
+      vector<vector<Tail> > tails(nodes.size());
+      vector<Tail> root;
+      for (int v=int(nodes.size())-1; v >= -1; v--) {
+         successors((v < 0)?start:nodes[v], start, next_nodes, true);
+         vector<Tail>& t=(v < 0)?root:tails[v];
+         if (next_nodes.empty()) {
+            t.push_back(Tail(0, -1, 0));
+         }
+         for (vector<Link>::const_iterator l=next_nodes.begin();
+           l != next_nodes.end(); ++l) {
+            int n=node(*l, offsets);
+            for (int r=0; r<int(tails[n].size()); r++) {
+               t.push_back(Tail(tails[n][r].links+1, n, r));
+            }
+         }
+         sort(t.begin(), t.end());
+         if (int(t.size()) > k) {
+            t.erase(t.begin()+k, t.end());
+         }
+      }
+      result.clear();
+      vector<Link> p;
+      for (int r=0; r<int(root.size()); r++) {
+         p.clear();
+         for (Tail t=root[r]; t.next >= 0; t=tails[t.next][t.rank]) {
+            p.push_back(nodes[t.next]);
+         }
+         result.push_back(Alignment());
+         build(p, result.back());
+      }
+   }
 
-   // Return an riterator to the end of the
-   // alignment of the two sentences.
-   vector<Alignment>::const_reverse_iterator
-   align_rend() const throw() { return alignments.rend(); }
+   // This procedure puts the parts that the segments of the alignments
+   // cover in result: those of the SAME segments if same is true and those
+   // of the DIFF segments if diff is true. They come in the order of the
+   // alignments and their segments, as next gives them, but a part that
+   // occurs again may be left out. The alignments are not built. What a
+   // path gives after a link only depends on the link and the first link
+   // of the SAME segment it is in, so the paths from there are walked
+   // once. It returns false if wall_time passes deadline (0 means none)
+   // before all paths are walked; result is incomplete then.
+   bool parts(const bool same, const bool diff, vector<Part>& result,
+     const double deadline=0) const {
+      vector<Link> nodes;
+      vector<int> offsets;
+      graph(nodes, offsets);
+      set<Link> walked;
+      result.clear();
+      return walk(start, start, same, diff, offsets, walked, result,
+        deadline);
+   }
 
 protected:
-   Setlinklist
-   find_all_links() throw() {
-      Linklist m=find_all_matching_terminals();
-      Setlinklist p;
-      p.insert(Linklist());
-      for (Linklist::iterator i=m.begin(); i != m.end(); i++) {
-         Setlinklist p_old;
-         p.swap(p_old);
-         Setlinklist p_align;
-         for (Setlinklist::iterator j=p_old.begin(); j != p_old.end(); j++) {
-            Linklist o;
-            o.clear();
-            ns_tools::copy_if
-              (j->begin(), j->end(), back_inserter(o), Overlap(*i));
-            if (o.empty()) {
-               Linklist j_new=*j;
-               j_new.push_back(*i);
-               p.insert(j_new);
-            } else {
-               Linklist j_new=*j;
-               p.insert(j_new);
-               Linklist::iterator new_end=
-                 remove_if(j_new.begin(), j_new.end(), In<Link>(o)); // -o
-               j_new.erase(new_end, j_new.end());
-               j_new.push_back(*i); // +i
-               p_align.insert(j_new);
+   // This procedure walks the paths from link l, whose SAME segment begins
+   // at link run (see parts). It returns false at the deadline.
+   bool walk(const Link& l, const Link& run, const bool same, const bool diff,
+     const vector<int>& offsets, set<Link>& walked, vector<Part>& result,
+     const double deadline) const {
+      if ((deadline > 0)&&(ns_stats::wall_time() > deadline)) {
+         return false;
+      }
+      vector<Link> next_nodes;
+      successors(l, start, next_nodes, true);
+      if (next_nodes.empty()) {
+         next_nodes.push_back(Link(len1, len2)); // the end of the sentences
+      }
+      for (vector<Link>::const_iterator n=next_nodes.begin();
+        n != next_nodes.end(); ++n) {
+         bool end=(n->first == len1);
+         Link n_run=*n;
+         if ((l != start)&&!end&&(n->first == l.first+1)
+           &&(n->second == l.second+1)) {
+            n_run=run;
+         } else {
+            if (same&&(l != start)) {
+               result.push_back(Part(run.first, l.first+1, run.second,
+                 l.second+1));
             }
-         }
-         Setlinklist insert_true;
-         for (Setlinklist::iterator
-           i=p_align.begin();i != p_align.end(); i++) {
-            Setlinklist::iterator next=i;
-            next++;
-            if ((find_if(p.begin(), p.end(), Subset(*i)) == p.end())
-              &&(find_if(p_align.begin(), i, Subset(*i)) == i)
-              &&(find_if(next, p_align.end(), Subset(*i)) == p_align.end())) {
-               insert_true.insert(*i);
+            if (diff&&((n->first-l.first > 1)||(n->second-l.second > 1))) {
+               result.push_back(Part(l.first+1, n->first, l.second+1,
+                 n->second));
             }
          }
-         p.insert(insert_true.begin(), insert_true.end());
+         if (!end&&walked.insert(Link(node(*n, offsets),
+           same?n->first-n_run.first:0)).second
+           &&!walk(*n, n_run, same, diff, offsets, walked, result, deadline)) {
+            return false;
+         }
       }
-      return p;
+      return true;
    }
 
-   Linklist
-   find_all_matching_terminals() {
-      Linklist res;
-      int i=0;
-      for (Ran i_i=begin1; i_i != end1; i_i++,i++) {
-         int j=0;
-         for (Ran j_i=begin2; j_i != end2; j_i++,j++) {
-            if (*i_i == *j_i) {
-               res.push_back(make_pair(i, j));
+   struct Tail {
+      // This class describes one of the longest paths from a link.
+      Tail(const int l, const int n, const int r) throw()
+        :links(l),next(n),rank(r) { }
+      bool operator<(const Tail& t) const throw() {
+         return (links > t.links)||((links == t.links)&&((next < t.next)
+           ||((next == t.next)&&(rank < t.rank))));
+      }
+      int links;   // links of the path after the link
+      int next;    // next link (-1 if none)
+      int rank;    // rank of the rest of the path among those of next
+   };
+
+   // This procedure puts the links that may directly follow link from and
+   // come after link after (in lexicographic order) in result, or only the
+   // first of them when all is false.
+   void successors(const Link& from, const Link& after, vector<Link>& result,
+     const bool all) const throw() {
+      result.clear();
+      int bound=len2; // the links may not go beyond an earlier equal word
+      for (int i=from.first+1; i<len1; i++) {
+         vector<int>::const_iterator j=
+           upper_bound(matches[i].begin(), matches[i].end(), from.second);
+         if ((j == matches[i].end())||(*j > bound)) {
+            continue;
+         }
+         int first=*j;
+         for (; (j != matches[i].end())&&(*j <= bound); ++j) {
+            if (Link(i, *j) > after) {
+               result.push_back(Link(i, *j));
+               if (!all) {
+                  return;
+               }
             }
          }
+         bound=first;
+      }
+   }
+
+   // This procedure puts all links in nodes in lexicographic order and,
+   // for every word of the first sentence, the index of its first link in
+   // offsets.
+   void graph(vector<Link>& nodes, vector<int>& offsets) const {
+      for (int i=0; i<len1; i++) {
+         offsets.push_back(nodes.size());
+         for (vector<int>::const_iterator j=matches[i].begin();
+           j != matches[i].end(); ++j) {
+            nodes.push_back(Link(i, *j));
+         }
+      }
+   }
+
+   // Return the index of link l in the nodes of graph.
+   int node(const Link& l, const vector<int>& offsets) const throw() {
+      return offsets[l.first]+int(lower_bound(matches[l.first].begin(),
+        matches[l.first].end(), l.second)-matches[l.first].begin());
+   }
+
+   // This procedure builds the alignment a that belongs to the links p.
+   void build(const vector<Link>& p, Alignment& a) const throw() {
+      a.clear();
+      int current_i=0, current_j=0;
+      for (vector<Link>::const_iterator l=p.begin(); l != p.end(); ++l) {
+         if ((current_i != l->first)||(current_j != l->second)) {
+            a.push_back(Segment(current_i, current_j,
+              l->first-current_i+l->second-current_j, DIFF));
+         }
+         add_forwards(a, SAME, l->first, l->second);
+         current_i=l->first+1;
+         current_j=l->second+1;
+      }
+      if ((current_i != len1)||(current_j != len2)) {
+         a.push_back(Segment(current_i, current_j,
+           len1-current_i+len2-current_j, DIFF));
       }
-      return res;
    }
 
 private:
-   vector<Edit_operation*> operations;
-   vector<Alignment> alignments;
-   Ran begin1, end1, begin2, end2;
+   int len1, len2;
+   vector<vector<int> > matches; // per word of the first sentence, the
+                                 // equal words of the second sentence
+   vector<Link> path;            // links of the current alignment
+   vector<Link> found;
+   Alignment alignment;
+   bool started;
+   static const Link start;      // stands for the begin of the sentences
 };
 
+template <class Ran>
+const Link All_alignment<Ran>::start(-1, -1);
+
 
 } // namespace
 
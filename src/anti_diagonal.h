@@ -0,0 +1,305 @@
+/******************************************************************************»
+ **
+ **   Filename    : anti_diagonal.h
+ **
+ **   Description : This file contains the definition of the class
+ **                 AD_biased. It computes the same alignment as WF_biased,
+ **                 but fills the edit distance matrix one anti-diagonal
+ **                 (i+j constant) at a time. The cells of an anti-diagonal
+ **                 do not depend on each other, so they are computed with
+ **                 SSE4.1 (4 cells) or AVX2 (8 cells) instructions. The
+ **                 instruction set is chosen at runtime; on other
+ **                 processors WF_biased should be used instead (see
+ **                 simd_lanes()).
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __anti_diagonal__
+#define __anti_diagonal__
+
+#include <algorithm>
+#include <vector>
+#include "edit_distance.h"
+#include "edit_operations.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AD_SIMD 1
+#include <immintrin.h>
+#else
+#define AD_SIMD 0
+#endif
+
+namespace ns_edit_distance {
+
+// Number of cells of the widest vector unit that may be used, or 0 if
+// no vector instructions are available.
+const int max_lanes=8;
+
+class Ad_buffer {
+   // This class is the scratch space of AD_biased. It stores three
+   // anti-diagonals of costs (indexed by i), the directions of all cells
+   // (anti-diagonal by anti-diagonal) and the word indices of the
+   // sentences. Like Dp_buffer, it keeps its capacity between pairs.
+public:
+   void resize(const int len1, const int len2) {
+      vector<float>::size_type cells=
+        vector<float>::size_type(len1+1)*(len2+1)+max_lanes;
+      if (directions.size() < cells) {
+         directions.resize(cells);
+      }
+      if (diagonals.size() < vector<float>::size_type(3*(len1+1+max_lanes))) {
+         diagonals.resize(3*(len1+1+max_lanes));
+      }
+      if (words.size() < vector<int>::size_type(len1+len2+max_lanes)) {
+         words.resize(len1+len2+max_lanes);
+      }
+   }
+
+   vector<float> diagonals;
+   vector<unsigned char> directions;
+   vector<int> words;
+};
+
+#if AD_SIMD
+// Return the number of cells the processor computes at once, as
+// simd_lanes() below, by asking the processor.
+inline int
+detect_lanes() throw() {
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) {
+      return 8;
+   } else if (__builtin_cpu_supports("sse4.1")) {
+      return 4;
+   }
+   return 0;
+}
+#endif
+
+// Return the number of cells the processor computes at once (8 with AVX2,
+// 4 with SSE4.1) or 0 if AD_biased cannot be used. The processor is asked
+// once, by the (thread safe) initialization of a local static, so the
+// workers of the thread pool and Batch_biased may call it concurrently.
+inline int
+simd_lanes() throw() {
+#if AD_SIMD
+   static const int lanes=detect_lanes();
+   return lanes;
+#else
+   return 0;
+#endif
+}
+
+#if AD_SIMD
+// These procedures compute the cells (i, k-i) for i in [lo, hi] of
+// anti-diagonal k. prev2 and prev1 hold anti-diagonals k-2 and k-1,
+// words1[i-1] is word i of the first sentence and words2[len2-j] word j
+// of the second. The operations are compared in the order INS, DEL, SUB
+// with the same arithmetic as Biased::sub (positions divided in double
+// precision), so the costs and directions are equal to those of
+// Wagner_fisher. The last vector may write up to
+// lanes-1 cells beyond hi, which are never read.
+__attribute__((target("avx2"))) inline void
+ad_cells_avx2(const int k, const int lo, const int hi, const int len1,
+  const int len2, const float* prev2, const float* prev1, float* curr,
+  unsigned char* dirs, const int* words1, const int* words2) {
+   const __m256i step=_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   const __m256d dl1=_mm256_set1_pd(double(len1));
+   const __m256d dl2=_mm256_set1_pd(double(len2));
+   const __m256 fsum=_mm256_set1_ps(float(len1+len2));
+   const __m256 half=_mm256_set1_ps(float(0.5));
+   const __m256 sign=_mm256_set1_ps(float(-0.0));
+   const __m256 one=_mm256_set1_ps(float(1));
+   const __m256 two=_mm256_set1_ps(float(2));
+   const __m256 op_del=_mm256_set1_ps(float(DEL));
+   const __m256 op_sub=_mm256_set1_ps(float(SUB));
+   for (int i=lo; i <= hi; i+=8) {
+      __m256 ins=_mm256_add_ps(_mm256_loadu_ps(prev1+i-1), one);
+      __m256 del=_mm256_add_ps(_mm256_loadu_ps(prev1+i), one);
+      __m256i w1=_mm256_loadu_si256((const __m256i*)(words1+i-1));
+      __m256i w2=_mm256_loadu_si256((const __m256i*)(words2+len2-k+i));
+      __m256 match=_mm256_castsi256_ps(_mm256_cmpeq_epi32(w1, w2));
+      __m256i vi=_mm256_add_epi32(_mm256_set1_epi32(i-1), step);
+      __m256i vj=_mm256_sub_epi32(_mm256_set1_epi32(k-i-1), step);
+      __m256 pos=_mm256_sub_ps(
+        _mm256_set_m128(
+          _mm256_cvtpd_ps(_mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(vi, 1)), dl1)),
+          _mm256_cvtpd_ps(_mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(vi)), dl1))),
+        _mm256_set_m128(
+          _mm256_cvtpd_ps(_mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(vj, 1)), dl2)),
+          _mm256_cvtpd_ps(_mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(vj)), dl2))));
+      pos=_mm256_mul_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, pos), fsum), half);
+      __m256 sub=_mm256_add_ps(_mm256_loadu_ps(prev2+i-1),
+        _mm256_blendv_ps(two, pos, match));
+      __m256 min=ins;
+      __m256 op=_mm256_setzero_ps(); // INS
+      __m256 less=_mm256_cmp_ps(del, min, _CMP_LT_OQ);
+      min=_mm256_blendv_ps(min, del, less);
+      op=_mm256_blendv_ps(op, op_del, less);
+      less=_mm256_cmp_ps(sub, min, _CMP_LT_OQ);
+      min=_mm256_blendv_ps(min, sub, less);
+      op=_mm256_blendv_ps(op, op_sub, less);
+      _mm256_storeu_ps(curr+i, min);
+      __m256i ops=_mm256_cvtps_epi32(op);
+      __m128i ops16=_mm_packs_epi32(_mm256_castsi256_si128(ops),
+        _mm256_extracti128_si256(ops, 1));
+      _mm_storel_epi64((__m128i*)(dirs+i-lo), _mm_packus_epi16(ops16, ops16));
+   }
+}
+
+__attribute__((target("sse4.1"))) inline void
+ad_cells_sse41(const int k, const int lo, const int hi, const int len1,
+  const int len2, const float* prev2, const float* prev1, float* curr,
+  unsigned char* dirs, const int* words1, const int* words2) {
+   const __m128i step=_mm_setr_epi32(0, 1, 2, 3);
+   const __m128d dl1=_mm_set1_pd(double(len1));
+   const __m128d dl2=_mm_set1_pd(double(len2));
+   const __m128 fsum=_mm_set1_ps(float(len1+len2));
+   const __m128 half=_mm_set1_ps(float(0.5));
+   const __m128 sign=_mm_set1_ps(float(-0.0));
+   const __m128 one=_mm_set1_ps(float(1));
+   const __m128 two=_mm_set1_ps(float(2));
+   const __m128 op_del=_mm_set1_ps(float(DEL));
+   const __m128 op_sub=_mm_set1_ps(float(SUB));
+   for (int i=lo; i <= hi; i+=4) {
+      __m128 ins=_mm_add_ps(_mm_loadu_ps(prev1+i-1), one);
+      __m128 del=_mm_add_ps(_mm_loadu_ps(prev1+i), one);
+      __m128i w1=_mm_loadu_si128((const __m128i*)(words1+i-1));
+      __m128i w2=_mm_loadu_si128((const __m128i*)(words2+len2-k+i));
+      __m128 match=_mm_castsi128_ps(_mm_cmpeq_epi32(w1, w2));
+      __m128i vi=_mm_add_epi32(_mm_set1_epi32(i-1), step);
+      __m128i vj=_mm_sub_epi32(_mm_set1_epi32(k-i-1), step);
+      __m128 pos=_mm_sub_ps(
+        _mm_movelh_ps(
+          _mm_cvtpd_ps(_mm_div_pd(_mm_cvtepi32_pd(vi), dl1)),
+          _mm_cvtpd_ps(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(vi, 8)), dl1))),
+        _mm_movelh_ps(
+          _mm_cvtpd_ps(_mm_div_pd(_mm_cvtepi32_pd(vj), dl2)),
+          _mm_cvtpd_ps(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(vj, 8)), dl2))));
+      pos=_mm_mul_ps(_mm_mul_ps(_mm_andnot_ps(sign, pos), fsum), half);
+      __m128 sub=_mm_add_ps(_mm_loadu_ps(prev2+i-1),
+        _mm_blendv_ps(two, pos, match));
+      __m128 min=ins;
+      __m128 op=_mm_setzero_ps(); // INS
+      __m128 less=_mm_cmplt_ps(del, min);
+      min=_mm_blendv_ps(min, del, less);
+      op=_mm_blendv_ps(op, op_del, less);
+      less=_mm_cmplt_ps(sub, min);
+      min=_mm_blendv_ps(min, sub, less);
+      op=_mm_blendv_ps(op, op_sub, less);
+      _mm_storeu_ps(curr+i, min);
+      __m128i ops=_mm_cvtps_epi32(op);
+      __m128i ops8=_mm_packus_epi16(_mm_packs_epi32(ops, ops), ops);
+      int packed=_mm_cvtsi128_si32(ops8);
+      copy((unsigned char*)&packed, (unsigned char*)&packed+4, dirs+i-lo);
+   }
+}
+#endif // AD_SIMD
+
+// Ran needs to be a random access iterator over Words. AD_biased may only
+// be used when simd_lanes() is not 0.
+template <class Ran>
+class AD_biased:public Edit_distance {
+public:
+   AD_biased(Ran b1, Ran e1, Ran b2, Ran e2, Ad_buffer& buf) throw()
+     :buffer(buf) {
+      len1=e1-b1;
+      len2=e2-b2;
+      buffer.resize(len1, len2);
+      build_matrix(b1, b2);
+      build_alignment();
+   }
+
+private:
+   // Return the index of the direction of cell (i, k-i) in the buffer.
+   int direction_index(const int k, const int i) const throw() {
+      return offsets[k]+i-max(0, k-len2);
+   }
+
+   void build_matrix(Ran b1, Ran b2) throw() {
+      int *words1=&buffer.words[0];
+      int *words2=&buffer.words[len1];
+      for (int i=0; i<len1; i++) {
+         words1[i]=(b1+i)->getIdx();
+      }
+      for (int j=0; j<len2; j++) {
+         words2[len2-1-j]=(b2+j)->getIdx(); // reversed
+      }
+      offsets.resize(len1+len2+2);
+      offsets[0]=0;
+      int stride=len1+1+max_lanes;
+      float *prev2=&buffer.diagonals[0];
+      float *prev1=&buffer.diagonals[stride];
+      float *curr=&buffer.diagonals[2*stride];
+      unsigned char *dirs=&buffer.directions[0];
+      curr[0]=0; // init step
+      cells_computed=1;
+      for (int k=1; k <= len1+len2; k++) {
+         int lo=max(0, k-len2), hi=min(len1, k);
+         cells_computed+=hi-lo+1;
+         offsets[k]=offsets[k-1]+min(len1, k-1)-max(0, k-1-len2)+1;
+         float *tmp=prev2;
+         prev2=prev1;
+         prev1=curr;
+         curr=tmp;
+         int inner_lo=max(1, lo), inner_hi=min(hi, k-1);
+         if (inner_lo <= inner_hi) {
+#if AD_SIMD
+            unsigned char *d=dirs+offsets[k]+inner_lo-lo;
+            if (simd_lanes() == 8) {
+               ad_cells_avx2(k, inner_lo, inner_hi, len1, len2, prev2, prev1,
+                 curr, d, words1, words2);
+            } else {
+               ad_cells_sse41(k, inner_lo, inner_hi, len1, len2, prev2, prev1,
+                 curr, d, words1, words2);
+            }
+#endif
+         }
+         if (lo == 0) { // cell (0, k)
+            curr[0]=prev1[0]+1;
+            dirs[offsets[k]]=DEL;
+         }
+         if (hi == k) { // cell (k, 0)
+            curr[k]=prev1[k-1]+1;
+            dirs[offsets[k]+k-lo]=INS;
+         }
+      }
+   }
+
+   // This procedure follows the stored directions from (len1, len2) back
+   // to (0, 0).
+   void build_alignment() throw() {
+      int i=len1, j=len2;
+      while((i != 0)||(j != 0)) {
+         Edit_operation op=
+           Edit_operation(buffer.directions[direction_index(i+j, i)]);
+         pair<int, int> prev=prev_coord(op, make_pair(i, j));
+         i=prev.first;
+         j=prev.second;
+         add_backwards(alignment, ((op == SUB)
+           &&(buffer.words[i] == buffer.words[len1+len2-1-j]))?SAME:DIFF,
+           i, j);
+      }
+      reverse(alignment.begin(), alignment.end());
+   }
+
+   Ad_buffer& buffer;
+   vector<int> offsets;
+   int len1, len2;
+};
+
+
+} // namespace
+
+#endif // __anti_diagonal__
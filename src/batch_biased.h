@@ -0,0 +1,263 @@
+/******************************************************************************»
+ **
+ **   Filename    : batch_biased.h
+ **
+ **   Description : This file contains the definition of the class
+ **                 Batch_biased. It aligns one sentence against a batch of
+ **                 other sentences (as WF_biased would align each pair).
+ **                 Every other sentence gets a lane of an SSE4.1 (4 lanes)
+ **                 or AVX2 (8 lanes) register, and the edit distance
+ **                 matrices of all lanes are filled row by row at the same
+ **                 time. Lanes of shorter sentences compute cells beyond the
+ **                 end of their sentence, which are ignored, so batches
+ **                 should hold sentences of similar length.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __batch_biased__
+#define __batch_biased__
+
+#include <algorithm>
+#include <vector>
+#include "anti_diagonal.h"
+#include "edit_distance.h"
+#include "edit_operations.h"
+
+namespace ns_edit_distance {
+
+class Batch_buffer {
+   // This class is the scratch space of Batch_biased. All arrays are
+   // interleaved: element x of lane l is stored at x*lanes+l. Like
+   // Dp_buffer, it keeps its capacity between batches.
+public:
+   void resize(const int len1, const int width) {
+      vector<float>::size_type cells=
+        vector<float>::size_type(len1+1)*(width+1)*max_lanes;
+      if (directions.size() < cells) {
+         directions.resize(cells);
+      }
+      if (rows.size() < vector<float>::size_type(2*(width+1)*max_lanes)) {
+         rows.resize(2*(width+1)*max_lanes);
+      }
+      if (words.size() < vector<int>::size_type((width+1)*max_lanes)) {
+         words.resize((width+1)*max_lanes);
+         positions.resize((width+1)*max_lanes);
+      }
+   }
+
+   vector<float> rows;
+   vector<unsigned char> directions;
+   vector<int> words;
+   vector<float> positions;
+};
+
+#if AD_SIMD
+// These procedures compute row i of the matrices of all lanes. prev and
+// curr hold rows i-1 and i, words2 and pos2 the word indices and relative
+// positions (as in Biased::sub) of the other sentences, sum their length
+// plus the length of the first sentence. As in ad_cells_avx2, the
+// operations are compared in the order INS, DEL, SUB.
+__attribute__((target("avx2"))) inline void
+batch_row_avx2(const int width, const int word1, const float pos1,
+  const float* prev, float* curr, unsigned char* dirs, const int* words2,
+  const float* pos2, const float* sum) {
+   const __m256 half=_mm256_set1_ps(float(0.5));
+   const __m256 sign=_mm256_set1_ps(float(-0.0));
+   const __m256 one=_mm256_set1_ps(float(1));
+   const __m256 two=_mm256_set1_ps(float(2));
+   const __m256 op_ins=_mm256_set1_ps(float(INS));
+   const __m256 op_del=_mm256_set1_ps(float(DEL));
+   const __m256 op_sub=_mm256_set1_ps(float(SUB));
+   const __m256i w1=_mm256_set1_epi32(word1);
+   const __m256 p1=_mm256_set1_ps(pos1);
+   const __m256 s=_mm256_loadu_ps(sum);
+   __m256 left=_mm256_add_ps(_mm256_loadu_ps(prev), one);
+   __m256 op=op_ins;
+   for (int j=0; ; j++) {
+      _mm256_storeu_ps(curr+8*j, left);
+      __m256i ops=_mm256_cvtps_epi32(op);
+      __m128i ops16=_mm_packs_epi32(_mm256_castsi256_si128(ops),
+        _mm256_extracti128_si256(ops, 1));
+      _mm_storel_epi64((__m128i*)(dirs+8*j), _mm_packus_epi16(ops16, ops16));
+      if (j == width) {
+         break;
+      }
+      __m256 ins=_mm256_add_ps(_mm256_loadu_ps(prev+8*(j+1)), one);
+      __m256 del=_mm256_add_ps(left, one);
+      __m256 match=_mm256_castsi256_ps(_mm256_cmpeq_epi32(w1,
+        _mm256_loadu_si256((const __m256i*)(words2+8*(j+1)))));
+      __m256 pos=_mm256_sub_ps(p1, _mm256_loadu_ps(pos2+8*(j+1)));
+      pos=_mm256_mul_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, pos), s), half);
+      __m256 sub=_mm256_add_ps(_mm256_loadu_ps(prev+8*j),
+        _mm256_blendv_ps(two, pos, match));
+      left=ins;
+      op=op_ins;
+      __m256 less=_mm256_cmp_ps(del, left, _CMP_LT_OQ);
+      left=_mm256_blendv_ps(left, del, less);
+      op=_mm256_blendv_ps(op, op_del, less);
+      less=_mm256_cmp_ps(sub, left, _CMP_LT_OQ);
+      left=_mm256_blendv_ps(left, sub, less);
+      op=_mm256_blendv_ps(op, op_sub, less);
+   }
+}
+
+__attribute__((target("sse4.1"))) inline void
+batch_row_sse41(const int width, const int word1, const float pos1,
+  const float* prev, float* curr, unsigned char* dirs, const int* words2,
+  const float* pos2, const float* sum) {
+   const __m128 half=_mm_set1_ps(float(0.5));
+   const __m128 sign=_mm_set1_ps(float(-0.0));
+   const __m128 one=_mm_set1_ps(float(1));
+   const __m128 two=_mm_set1_ps(float(2));
+   const __m128 op_ins=_mm_set1_ps(float(INS));
+   const __m128 op_del=_mm_set1_ps(float(DEL));
+   const __m128 op_sub=_mm_set1_ps(float(SUB));
+   const __m128i w1=_mm_set1_epi32(word1);
+   const __m128 p1=_mm_set1_ps(pos1);
+   const __m128 s=_mm_loadu_ps(sum);
+   __m128 left=_mm_add_ps(_mm_loadu_ps(prev), one);
+   __m128 op=op_ins;
+   for (int j=0; ; j++) {
+      _mm_storeu_ps(curr+4*j, left);
+      __m128i ops=_mm_cvtps_epi32(op);
+      __m128i ops8=_mm_packus_epi16(_mm_packs_epi32(ops, ops), ops);
+      int packed=_mm_cvtsi128_si32(ops8);
+      copy((unsigned char*)&packed, (unsigned char*)&packed+4, dirs+4*j);
+      if (j == width) {
+         break;
+      }
+      __m128 ins=_mm_add_ps(_mm_loadu_ps(prev+4*(j+1)), one);
+      __m128 del=_mm_add_ps(left, one);
+      __m128 match=_mm_castsi128_ps(_mm_cmpeq_epi32(w1,
+        _mm_loadu_si128((const __m128i*)(words2+4*(j+1)))));
+      __m128 pos=_mm_sub_ps(p1, _mm_loadu_ps(pos2+4*(j+1)));
+      pos=_mm_mul_ps(_mm_mul_ps(_mm_andnot_ps(sign, pos), s), half);
+      __m128 sub=_mm_add_ps(_mm_loadu_ps(prev+4*j),
+        _mm_blendv_ps(two, pos, match));
+      left=ins;
+      op=op_ins;
+      __m128 less=_mm_cmplt_ps(del, left);
+      left=_mm_blendv_ps(left, del, less);
+      op=_mm_blendv_ps(op, op_del, less);
+      less=_mm_cmplt_ps(sub, left);
+      left=_mm_blendv_ps(left, sub, less);
+      op=_mm_blendv_ps(op, op_sub, less);
+   }
+}
+#endif // AD_SIMD
+
+// Ran needs to be a random access iterator over Words. Batch_biased may
+// only be used when simd_lanes() is not 0, and others may hold at most
+// simd_lanes() sentences.
+template <class Ran>
+class Batch_biased {
+public:
+   Batch_biased(Ran b1, Ran e1, const vector<pair<Ran, Ran> >& others,
+     Batch_buffer& buf) throw():buffer(buf),begin1(b1) {
+      lanes=simd_lanes();
+      len1=e1-b1;
+      width=0;
+      for (typename vector<pair<Ran, Ran> >::const_iterator o=others.begin();
+        o != others.end(); ++o) {
+         len2.push_back(o->second-o->first);
+         width=max(width, len2.back());
+      }
+      buffer.resize(len1, width);
+      build_matrices(b1, others);
+      alignments.resize(others.size());
+      for (int l=0; l<int(others.size()); l++) {
+         build_alignment(l);
+      }
+   }
+
+   // Return the alignment of the first sentence with others[l].
+   const Alignment&
+   alignment(const int l) const throw() {
+      return alignments[l];
+   }
+
+   // Return the number of cells of the matrix of others[l] (the lanes of
+   // shorter sentences also compute the cells up to the widest one, which
+   // are not counted).
+   long
+   cells(const int l) const throw() {
+      return long(len1+1)*(len2[l]+1);
+   }
+
+private:
+   void build_matrices(Ran b1, const vector<pair<Ran, Ran> >& others) throw() {
+      int *words2=&buffer.words[0];
+      float *pos2=&buffer.positions[0];
+      vector<float> sum(lanes, 0);
+      fill(words2, words2+(width+1)*lanes, -1);
+      fill(pos2, pos2+(width+1)*lanes, float(0));
+      for (int l=0; l<int(others.size()); l++) {
+         for (int j=1; j<=len2[l]; j++) {
+            words2[j*lanes+l]=(others[l].first+j-1)->getIdx();
+            pos2[j*lanes+l]=float(double(j-1)/len2[l]);
+         }
+         sum[l]=float(len1+len2[l]);
+      }
+      float *prev=&buffer.rows[0];
+      float *curr=&buffer.rows[(width+1)*lanes];
+      unsigned char *dirs=&buffer.directions[0];
+      for (int j=0; j<=width; j++) { // init step
+         for (int l=0; l<lanes; l++) {
+            curr[j*lanes+l]=j;
+            dirs[j*lanes+l]=DEL;
+         }
+      }
+      for (int i=1; i<=len1; i++) {
+         swap(prev, curr);
+         dirs+=(width+1)*lanes;
+         int word1=(b1+i-1)->getIdx();
+         float pos1=float(double(i-1)/len1);
+#if AD_SIMD
+         if (lanes == 8) {
+            batch_row_avx2(width, word1, pos1, prev, curr, dirs, words2, pos2,
+              &sum[0]);
+         } else {
+            batch_row_sse41(width, word1, pos1, prev, curr, dirs, words2, pos2,
+              &sum[0]);
+         }
+#endif
+      }
+   }
+
+   // This procedure follows the stored directions of lane l from
+   // (len1, len2[l]) back to (0, 0).
+   void build_alignment(const int l) throw() {
+      Alignment& alignment=alignments[l];
+      int i=len1, j=len2[l];
+      while((i != 0)||(j != 0)) {
+         Edit_operation op=Edit_operation(
+           buffer.directions[(i*(width+1)+j)*lanes+l]);
+         pair<int, int> prev=prev_coord(op, make_pair(i, j));
+         i=prev.first;
+         j=prev.second;
+         add_backwards(alignment, ((op == SUB)
+           &&(buffer.words[(j+1)*lanes+l] == (begin1+i)->getIdx()))?SAME:DIFF,
+           i, j);
+      }
+      reverse(alignment.begin(), alignment.end());
+   }
+
+   Batch_buffer& buffer;
+   Ran begin1;
+   vector<Alignment> alignments;
+   vector<int> len2;
+   int lanes, len1, width;
+};
+
+
+} // namespace
+
+#endif // __batch_biased__
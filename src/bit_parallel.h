@@ -0,0 +1,177 @@
+/******************************************************************************»
+ **
+ **   Filename    : bit_parallel.h
+ **
+ **   Description : This file contains the definition of the class
+ **                 BP_default. It computes the same alignment as
+ **                 WF_default (ins=del=1, sub=2, mat=0), but uses a
+ **                 bit-parallel longest common subsequence computation
+ **                 (Hyyro) instead of the edit distance matrix. With
+ **                 these costs the edit distance of S and T is
+ **                 |S|+|T|-2*LCS(S, T). One machine word handles 64 words
+ **                 of the second sentence, longer sentences use several
+ **                 machine words per row.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __bit_parallel__
+#define __bit_parallel__
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <stdint.h>
+#include "edit_distance.h"
+#include "edit_operations.h"
+
+namespace ns_edit_distance {
+
+typedef uint64_t Bits;
+const int bits_per_word=64;
+
+// Return the number of set bits in b.
+inline int
+popcount(Bits b) throw() {
+#ifdef __GNUC__
+   return __builtin_popcountll(b);
+#else
+   int c=0;
+   for (; b; b&=b-1) { c++; }
+   return c;
+#endif
+}
+
+// Ran needs to be a random access iterator over Words.
+template <class Ran>
+class BP_default:public Edit_distance {
+public:
+   // This procedure computes the LCS rows and the alignment. When the
+   // edit cost exceeds max_distance (if not negative), the pair is
+   // abandoned and no alignment is built.
+   BP_default(Ran b1, Ran e1, Ran b2, Ran e2, float max_distance=-1) throw() {
+      len1=e1-b1;
+      len2=e2-b2;
+      if ((max_distance >= 0)&&(abs(len1-len2) > max_distance)) {
+         abandoned_flag=true;
+         return;
+      }
+      build_rows(b1, b2);
+      cells_computed=long(len1)*len2; // bits_per_word at a time
+      if ((max_distance >= 0)&&(give_cost(len1, len2) > max_distance)) {
+         abandoned_flag=true;
+         return;
+      }
+      build_alignment();
+   }
+
+   // Return the edit cost between the first i words of the first sentence
+   // and the first j words of the second sentence.
+   float
+   give_cost(const int i, const int j) const throw() {
+      if ((i<0)||(j<0)) { return 0; }
+      return i+j-2*lcs(i, j);
+   }
+
+private:
+   // Row i (of width words) holds a bit for each word of the second
+   // sentence. Bit j-1 is zero iff LCS(i, j) = LCS(i, j-1)+1.
+   void build_rows(Ran b1, Ran b2) throw() {
+      width=(len2+bits_per_word-1)/bits_per_word;
+      rows.assign((len1+1)*width, ~Bits(0));
+      if (width == 0) {
+         return;
+      }
+
+      // match vectors of the distinct words in the second sentence
+      vector<pair<int, int> > words;
+      for (int j=0; j<len2; j++) {
+         words.push_back(make_pair((b2+j)->getIdx(), j));
+      }
+      sort(words.begin(), words.end());
+      vector<int> keys;
+      vector<Bits> peq;
+      for (vector<pair<int, int> >::const_iterator w=words.begin();
+        w != words.end(); ++w) {
+         if (keys.empty()||(keys.back() != w->first)) {
+            keys.push_back(w->first);
+            peq.resize(peq.size()+width, Bits(0));
+         }
+         peq[peq.size()-width+w->second/bits_per_word]|=
+           Bits(1) << (w->second%bits_per_word);
+      }
+
+      for (int i=1; i<=len1; i++) {
+         const Bits *prev=&rows[(i-1)*width];
+         Bits *curr=&rows[i*width];
+         vector<int>::const_iterator k=
+           lower_bound(keys.begin(), keys.end(), (b1+i-1)->getIdx());
+         if ((k == keys.end())||(*k != (b1+i-1)->getIdx())) {
+            copy(prev, prev+width, curr); // no match in this row
+            continue;
+         }
+         const Bits *match=&peq[(k-keys.begin())*width];
+         Bits carry=0;
+         for (int w=0; w<width; w++) {
+            Bits u=prev[w]&match[w];
+            Bits sum=prev[w]+carry;
+            carry=(sum < carry);
+            sum+=u;
+            carry|=(sum < u);
+            curr[w]=sum|(prev[w]&~u);
+         }
+      }
+   }
+
+   // Return LCS(i, j): the number of zero bits below bit j in row i.
+   int lcs(const int i, const int j) const throw() {
+      if (width == 0) { return 0; }
+      const Bits *row=&rows[i*width];
+      int ones=0;
+      for (int w=0; w<j/bits_per_word; w++) {
+         ones+=popcount(row[w]);
+      }
+      if (j%bits_per_word != 0) {
+         ones+=popcount(row[j/bits_per_word]
+           &((Bits(1) << (j%bits_per_word))-1));
+      }
+      return j-ones;
+   }
+
+   // This procedure follows the same preference as the trace back of
+   // Wagner_fisher: insertion, then deletion, then substitution.
+   void build_alignment() throw() {
+      int i=len1, j=len2;
+      int l=lcs(i, j);
+      while((i != 0)||(j != 0)) {
+         if ((i > 0)&&(lcs(i-1, j) == l)) {
+            i--; // insertion
+            add_backwards(alignment, DIFF, i, j);
+         } else if ((j > 0)&&
+           (((rows[i*width+(j-1)/bits_per_word]>>((j-1)%bits_per_word))&1))) {
+            j--; // deletion
+            add_backwards(alignment, DIFF, i, j);
+         } else {
+            i--; j--; l--; // a match
+            add_backwards(alignment, SAME, i, j);
+         }
+      }
+      reverse(alignment.begin(), alignment.end());
+   }
+
+   int len1, len2;
+   int width;
+   vector<Bits> rows;
+};
+
+
+} // namespace
+
+#endif // __bit_parallel__
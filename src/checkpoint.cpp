@@ -0,0 +1,269 @@
+/******************************************************************************»
+ **
+ **   Filename    : checkpoint.cpp
+ **
+ **   Description : This file contains the implementation of the classes
+ **                 Archive and Checkpoint_writer.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <stdint.h>
+#include "checkpoint.h"
+#include "constituent.h"
+#include "nonterminal.h"
+#include "tree.h"
+#include "word.h"
+
+using ns_constituent::Constituent;
+using ns_nonterminal::Nonterminal;
+using ns_tree::Tree;
+using ns_word::Word;
+
+namespace ns_checkpoint {
+
+// The first bytes of a checkpoint file (with the version of the format).
+const char magic[]="ABL checkpoint 1\n";
+
+void Archive::put(const string& s) throw() {
+   put(uint32_t(s.size()));
+   data.insert(data.end(), s.begin(), s.end());
+}
+
+void Archive::get(string& s) throw() {
+   uint32_t n=0;
+   get(n);
+   if (!good||(pos+n > data.size())) {
+      good=false;
+      return;
+   }
+   s.assign(&data[0]+pos, n);
+   pos+=n;
+}
+
+void Archive::put(const Treebank& tb) throw() {
+   put(int32_t(Word::vocabulary_size()));
+   for (int i=1; i<=Word::vocabulary_size(); i++) {
+      put(Word::vocabulary(i));
+   }
+   put(uint64_t(Nonterminal::next_number()));
+   put(uint32_t(tb.comments.size()));
+   for (vector<string>::const_iterator c=tb.comments.begin();
+     c != tb.comments.end(); ++c) {
+      put(*c);
+   }
+   put(uint32_t(tb.size()));
+   for (Treebank::const_iterator t=tb.begin(); t != tb.end(); ++t) {
+      put(t->comment_line);
+      put(uint32_t(t->size()));
+      for (Tree::const_iterator w=t->begin(); w != t->end(); ++w) {
+         put(int32_t(w->getIdx()));
+      }
+      put(uint32_t(t->struc_size()));
+      for (Tree::const_struc_iterator c=t->struc_begin(); c != t->struc_end();
+        ++c) {
+         put(uint32_t(c->give_begin()));
+         put(uint32_t(c->give_end()));
+         put(uint32_t(c->size()));
+         for (Constituent::const_iterator n=c->begin(); n != c->end(); ++n) {
+            put(uint64_t(n->number()));
+         }
+      }
+   }
+}
+
+void Archive::get(Treebank& tb) throw() {
+   int32_t words=0;
+   get(words);
+   vector<Word> vocabulary(1);
+   for (int i=1; good&&(i<=words); i++) {
+      string w;
+      get(w);
+      try {
+         vocabulary.push_back(Word(w));
+      } catch (ns_word::InvalidWord) {
+         good=false;
+      }
+      if (good&&(vocabulary.back().getIdx() != i)) { // not a new vocabulary
+         good=false;
+      }
+   }
+   uint64_t next=0;
+   get(next);
+   uint32_t n=0;
+   get(n);
+   for (uint32_t i=0; good&&(i<n); i++) {
+      string c;
+      get(c);
+      tb.comments.push_back(c);
+   }
+   get(n);
+   for (uint32_t i=0; good&&(i<n); i++) {
+      tb.push_back(Tree());
+      Tree& t=tb.back();
+      get(t.comment_line);
+      uint32_t size=0;
+      get(size);
+      for (uint32_t j=0; good&&(j<size); j++) {
+         int32_t w=0;
+         get(w);
+         if ((w < 1)||(w > words)) {
+            good=false;
+            break;
+         }
+         t.push_back(vocabulary[w]);
+      }
+      get(size);
+      for (uint32_t j=0; good&&(j<size); j++) {
+         uint32_t b=0, e=0, nts=0;
+         get(b);
+         get(e);
+         get(nts);
+         Constituent c(b, e);
+         for (uint32_t k=0; good&&(k<nts); k++) {
+            uint64_t nt=0;
+            get(nt);
+            c.push_back(Nonterminal(nt));
+         }
+         t.add_structure(c);
+      }
+   }
+   Nonterminal::set_next_number(next);
+   tb.set_current_index(0);
+}
+
+bool Archive::read(const string& name) throw() {
+   ifstream is(name.c_str(), ios::binary);
+   char m[sizeof(magic)-1];
+   uint64_t size=0;
+   if (!is.read(m, sizeof(m))||(memcmp(m, magic, sizeof(m)) != 0)
+     ||!is.read((char*)&size, sizeof(size))) {
+      return false;
+   }
+   data.resize(size);
+   pos=0;
+   good=true;
+   return (size == 0)||is.read(&data[0], size);
+}
+
+Checkpoint_writer::Checkpoint_writer(const string& n) throw()
+  :written(0),failed(0),name(n) {
+#ifdef HAVE_PTHREAD_H
+   pthread_mutex_init(&lock, 0);
+   pthread_cond_init(&wake, 0);
+   writing=false;
+   stop=false;
+   started=(pthread_create(&thread, 0, work, this) == 0);
+#endif
+}
+
+Checkpoint_writer::~Checkpoint_writer() {
+#ifdef HAVE_PTHREAD_H
+   if (started) {
+      wait();
+      pthread_mutex_lock(&lock);
+      stop=true;
+      pthread_cond_broadcast(&wake);
+      pthread_mutex_unlock(&lock);
+      pthread_join(thread, 0);
+   }
+   pthread_cond_destroy(&wake);
+   pthread_mutex_destroy(&lock);
+#endif
+}
+
+bool Checkpoint_writer::busy() throw() {
+#ifdef HAVE_PTHREAD_H
+   pthread_mutex_lock(&lock);
+   bool b=writing;
+   pthread_mutex_unlock(&lock);
+   return b;
+#else
+   return false;
+#endif
+}
+
+void Checkpoint_writer::wait() throw() {
+#ifdef HAVE_PTHREAD_H
+   pthread_mutex_lock(&lock);
+   while (writing) {
+      pthread_cond_wait(&wake, &lock);
+   }
+   pthread_mutex_unlock(&lock);
+#endif
+}
+
+void Checkpoint_writer::write(Archive& a) throw() {
+#ifdef HAVE_PTHREAD_H
+   if (started) {
+      pthread_mutex_lock(&lock);
+      while (writing) {
+         pthread_cond_wait(&wake, &lock);
+      }
+      pending.swap(a.data);
+      writing=true;
+      pthread_cond_broadcast(&wake);
+      pthread_mutex_unlock(&lock);
+      a.data.clear();
+      return;
+   }
+#endif
+   save(a.data);
+   a.data.clear();
+}
+
+void Checkpoint_writer::save(const vector<char>& data) throw() {
+   string tmp=name+".tmp";
+   bool ok;
+   {
+      ofstream os(tmp.c_str(), ios::binary);
+      uint64_t size=data.size();
+      os.write(magic, sizeof(magic)-1);
+      os.write((const char*)&size, sizeof(size));
+      if (!data.empty()) {
+         os.write(&data[0], data.size());
+      }
+      os.close();
+      ok=os.good();
+   }
+   if (ok&&(rename(tmp.c_str(), name.c_str()) == 0)) {
+      written++;
+   } else {
+      failed++;
+   }
+}
+
+#ifdef HAVE_PTHREAD_H
+void* Checkpoint_writer::work(void* arg) {
+   Checkpoint_writer* w=(Checkpoint_writer*)arg;
+   pthread_mutex_lock(&w->lock);
+   for (;;) {
+      while (!w->writing&&!w->stop) {
+         pthread_cond_wait(&w->wake, &w->lock);
+      }
+      if (!w->writing) { // stopped and nothing left to write
+         break;
+      }
+      pthread_mutex_unlock(&w->lock);
+      w->save(w->pending);
+      pthread_mutex_lock(&w->lock);
+      vector<char>().swap(w->pending);
+      w->writing=false;
+      pthread_cond_broadcast(&w->wake);
+   }
+   pthread_mutex_unlock(&w->lock);
+   return 0;
+}
+#endif
+
+
+} // namespace
@@ -0,0 +1,137 @@
+/******************************************************************************»
+ **
+ **   Filename    : checkpoint.h
+ **
+ **   Description : This file contains the definitions of the classes
+ **                 Archive and Checkpoint_writer. An Archive holds the
+ **                 state of a run (the treebank with the vocabulary and
+ **                 the nonterminal counter, and whatever numbers the
+ **                 program adds) in a compact binary form. The
+ **                 Checkpoint_writer writes archives to a file in a
+ **                 thread of its own, so a run only stops to fill the
+ **                 archive. Numbers are stored as they are in memory, so
+ **                 a checkpoint can only be read on the same kind of
+ **                 machine.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __checkpoint__
+#define __checkpoint__
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "treebank.h"
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+namespace ns_checkpoint {
+
+using ns_treebank::Treebank;
+
+class Archive {
+public:
+   Archive() throw():good(true),pos(0) { }
+
+   // These procedures append x to the archive. Strings are preceded by
+   // their length.
+   template <class T>
+   void put(const T& x) throw() {
+      const char* p=(const char*)&x;
+      data.insert(data.end(), p, p+sizeof(T));
+   }
+   void put(const string&) throw();
+
+   // This procedure appends the treebank, the vocabulary and the number
+   // of the next new nonterminal.
+   void put(const Treebank&) throw();
+
+   // These procedures read x from the archive. Reading past the end
+   // clears good.
+   template <class T>
+   void get(T& x) throw() {
+      if (pos+sizeof(T) > data.size()) {
+         good=false;
+         return;
+      }
+      memcpy(&x, &data[pos], sizeof(T));
+      pos+=sizeof(T);
+   }
+   void get(string&) throw();
+
+   // This procedure reads a treebank into the empty treebank tb. It also
+   // restores the vocabulary (which should still be empty) and the number
+   // of the next new nonterminal.
+   void get(Treebank&) throw();
+
+   // This procedure reads the archive from file name (written by a
+   // Checkpoint_writer). It returns false if that fails.
+   bool read(const string& name) throw();
+
+   bool good;           // false after a failed get
+   vector<char> data;
+   size_t pos;          // position of the next get
+};
+
+class Checkpoint_writer {
+   // This class writes archives to the file name. An archive is first
+   // written to a temporary file, which then replaces the previous
+   // checkpoint, so the file always holds a complete checkpoint. Without
+   // POSIX threads the archive is written right away.
+public:
+   Checkpoint_writer(const string& n) throw();
+
+   ~Checkpoint_writer();
+
+   // Return true if a checkpoint is still being written.
+   bool busy() throw();
+
+   // This procedure waits until the last checkpoint is written.
+   void wait() throw();
+
+   // This procedure takes the data of a (which is left empty) and writes
+   // it in the background.
+   void write(Archive& a) throw();
+
+   int written;   // checkpoints written
+   int failed;    // checkpoints that could not be written
+
+private:
+   Checkpoint_writer(const Checkpoint_writer&);
+   Checkpoint_writer& operator=(const Checkpoint_writer&);
+
+   // This procedure writes data to the file.
+   void save(const vector<char>& data) throw();
+
+   string name;
+#ifdef HAVE_PTHREAD_H
+   // This procedure is the main loop of the writing thread.
+   static void* work(void*);
+
+   pthread_t thread;
+   pthread_mutex_t lock;
+   pthread_cond_t wake;
+   vector<char> pending;  // the archive that is being written
+   bool writing;
+   bool stop;
+   bool started;
+#endif
+};
+
+
+} // namespace
+
+#endif // __checkpoint__
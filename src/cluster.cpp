@@ -22,6 +22,7 @@
 #include <iomanip>
 #include <sstream>
 #include <ctime>
+#include "stats.h"
 #include "tools.h"
 #include "constituent.h"
 #include "nonterminal.h"
@@ -74,6 +75,8 @@ using ns_tools::error;
 using ns_tools::warning;
 using ns_tools::debug;
 using ns_tools::getDate;
+using ns_stats::Histogram;
+using ns_stats::Stats;
 
 using std::ifstream;
 using std::ofstream;
@@ -90,6 +93,7 @@ static struct option long_options[] = {
    {"help", no_argument, 0, 'h'},
    {"input", required_argument, 0, 'i'},
    {"output", required_argument, 0, 'o'},
+   {"stats", required_argument, 0, 'T'},
    {"verbose", no_argument, 0, 'v'},
    {"version", no_argument, 0, 'V'},
    {0, 0, 0, 0}
@@ -109,6 +113,9 @@ int hyps_cnt=0;
 bool debug_flag=false;
 // Print processing information
 bool verbose_flag=false;
+// Figures of the run and the file they are written to (empty means none)
+Stats stats;
+string stats_file;
 
 // unique NT input
 int unti=0;
@@ -141,6 +148,10 @@ usage() {
    cerr << "Name of output file (- means stdout, default)" << endl;
    cerr << "  -d, --debug        ";
    cerr << "Output debug information" << endl;
+   cerr << "  -T, --stats=FILE   ";
+   cerr << "Write the timing of the phases and the counters of the run" << endl;
+   cerr << "                     ";
+   cerr << "to FILE (in JSON)" << endl;
    cerr << "  -h, --help         ";
    cerr << "Show this help and exit" << endl;
    cerr << "  -v, --verbose      ";
@@ -153,7 +164,7 @@ usage() {
 void handle_arguments(int argc, char* argv[]) {
    int opt;
    int option_index;
-   const char* optstring="dhi:mo:vV";
+   const char* optstring="dhi:mo:T:vV";
    program_name=argv[0];
    bool input_ok=false, output_ok=false;
    while ((opt=getopt_long_only(argc,argv,optstring,long_options,&option_index))
@@ -190,6 +201,9 @@ void handle_arguments(int argc, char* argv[]) {
                output_ok=true;
             }
             break;
+         case 'T':
+            stats_file=optarg;
+            break;
          case 'v':
             verbose_flag = true;
             break;
@@ -381,16 +395,35 @@ void write_infoheader(const Treebank& tb, char** args, int& argsc, int& c, int&
 }
 
 
+// This procedure writes the statistics of the run to the stats file.
+void write_stats(const Treebank& tb, int argc, char* argv[]) {
+   stats.end();
+   stats.set("sentences", tb.size());
+   stats.set("hypotheses_loaded", hyps_cnt);
+   stats.set("nonterminals_input", unti);
+   stats.set("nonterminals_output", unto);
+   Histogram& lengths=stats.histogram("sentence_length");
+   for (Treebank::const_iterator t=tb.begin(); t != tb.end(); ++t) {
+      lengths.add(t->size());
+   }
+   if (!stats.write(stats_file, program_name, argc, argv)) {
+      warning(program_name, "cannot write statistics to "+stats_file);
+   }
+}
+
 int main(int argc, char* argv[]) {
    const clock_t startTime = clock();
    handle_arguments(argc, argv);
+   stats.begin("read");
    Treebank tb;
    read_treebank(tb);
    if (verbose_flag) {
       cerr << program_name << ": # sentences loaded            : "
          << tb.size() << endl;
    }
+   stats.begin("cluster");
    cluster(tb);
+   stats.begin("write");
    write_infoheader(tb, argv,argc,unti,unto);
    write_treebank(tb);
    outit();
@@ -408,5 +441,8 @@ int main(int argc, char* argv[]) {
       cerr << program_name << ": # seconds execution time      : "
          << (double)(clock()-startTime)/CLOCKS_PER_SEC << endl;
    }
+   if (!stats_file.empty()) {
+      write_stats(tb, argc, argv);
+   }
    return 0;
 }
@@ -2,9 +2,9 @@
  **
  **   Filename    : edit_distance.h
  **
- **   Description : This file contains the abstract base class
- **                 Edit_operation. Specific instances of the edit
- **                 distance algorithm may be derived from this class.
+ **   Description : This file contains the base class Edit_distance.
+ **                 Specific instances of the edit distance algorithm
+ **                 may be derived from this class.
  **
  **   Version     : $Id: edit_distance.h 3755 2010-02-19 11:23:46Z menno $
  **
@@ -24,53 +24,106 @@
 
 namespace ns_edit_distance {
 
-typedef vector<const Edit_operation*> Alignment;
+// The kinds of segments: SAME segments link equal words of the two
+// sentences, DIFF segments hold the words in between.
+enum Segment_kind { SAME, DIFF };
 
-struct Bad_operations {
+struct Segment {
+   // This class describes a maximal run of edit operations of one kind. It
+   // starts at word begin1 of the first and word begin2 of the second
+   // sentence (0 is the first word). length is the number of edit
+   // operations, which for a SAME segment is the number of linked words.
+   // A DIFF segment ends where the next segment (or the sentence) begins.
+   Segment(const int b1, const int b2, const int l, const Segment_kind k)
+     throw():begin1(b1),begin2(b2),length(l),kind(k) { }
+   int begin1, begin2;
+   int length;
+   Segment_kind kind;
 };
 
-class Edit_distance {
+// An alignment is the list of its segments, alternating between SAME and
+// DIFF.
+typedef vector<Segment> Alignment;
+
+// This procedure adds an edit operation of the given kind, which starts at
+// words (i, j), to the end of the alignment a.
+inline void
+add_forwards(Alignment& a, const Segment_kind kind, const int i, const int j)
+  throw() {
+   if ((!a.empty())&&(a.back().kind == kind)) {
+      a.back().length++;
+   } else {
+      a.push_back(Segment(i, j, 1, kind));
+   }
+}
+
+// This procedure adds an edit operation of the given kind, which starts at
+// words (i, j), before the operations in a. Such an alignment is built
+// from the end of the sentences and it is in reverse order, so when all
+// operations are added, it needs to be reversed.
+inline void
+add_backwards(Alignment& a, const Segment_kind kind, const int i, const int j)
+  throw() {
+   if ((!a.empty())&&(a.back().kind == kind)) {
+      a.back().begin1=i;
+      a.back().begin2=j;
+      a.back().length++;
+   } else {
+      a.push_back(Segment(i, j, 1, kind));
+   }
+}
+
+class Dp_buffer {
+   // This class stores the edit distance matrix together with, for each
+   // cell, the edit operation that gave the cell its value. The cells are
+   // kept row by row in one block, which keeps its capacity between
+   // sentence pairs. Aligning many pairs with the same buffer only
+   // allocates memory when a pair is larger than all earlier ones.
 public:
-   Edit_distance(vector<Edit_operation*>& op):operations(op) { }
-   virtual ~Edit_distance() { }
-
-   virtual pair<float, const Edit_operation*>
-   min_gamma(pair<const int, const int> p) const throw(Bad_operations) {
-      vector<Edit_operation*>::const_iterator op=operations.begin();
-      if(op==operations.end()) {
-         throw Bad_operations();
-      }
-      pair<int, int> prev=(*op)->prev_coord(p);
-      while((prev.first<0)||(prev.second<0)) {
-         op++;
-         if(op==operations.end()) {
-            throw Bad_operations();
-         }
-         prev=(*op)->prev_coord(p);
-      }
-      pair<float, const Edit_operation*> min=(*op)->gamma(p);
-      min.first+=matrix[prev.first][prev.second];
-      op++;
-      while(op!=operations.end()) {
-         prev=(*op)->prev_coord(p);
-         if ((prev.first>=0)&&(prev.second>=0)) {
-            pair<float, const Edit_operation*> next=(*op)->gamma(p);
-            next.first+=matrix[prev.first][prev.second];
-            if (next.first<min.first) {
-               min=next;
-            }
-         }
-         op++;
+   Dp_buffer() throw():width(0) { }
+
+   // This procedure prepares the buffer for a matrix of rows x cols
+   // cells. The values of the cells are undefined.
+   void resize(const int rows, const int cols) {
+      width=cols;
+      vector<float>::size_type size=vector<float>::size_type(rows)*cols;
+      if (costs.size() < size) {
+         costs.resize(size);
+         directions.resize(size);
       }
-      return min;
    }
 
-   // Return the edit cost between the two sentences.
-   virtual float
-   give_cost(const int i, const int j) const throw() {
-      if ((i<0)||(j<0)) { return 0; }
-      return matrix[i][j];
+   float& cost(const int i, const int j) throw() {
+      return costs[vector<float>::size_type(i)*width+j];
+   }
+   float cost(const int i, const int j) const throw() {
+      return costs[vector<float>::size_type(i)*width+j];
+   }
+   unsigned char& direction(const int i, const int j) throw() {
+      return directions[vector<unsigned char>::size_type(i)*width+j];
    }
+private:
+   vector<float> costs;
+   vector<unsigned char> directions;
+   int width;
+};
+
+class Edit_distance {
+   // This class holds the result of an edit distance algorithm: the
+   // alignment of the two sentences, or nothing if the pair was abandoned.
+public:
+   Edit_distance(Dp_buffer* buf=0) throw()
+     :buffer(buf),abandoned_flag(false),cells_computed(0) { }
+
+   // Return true if the pair was given up on before an alignment was built.
+   bool
+   abandoned() const throw() { return abandoned_flag; }
+
+   // Return the number of cells of the edit distance matrix that were
+   // computed (cells outside the band, rows after the pair was abandoned
+   // and cells left as they were are not counted).
+   long
+   cells() const throw() { return cells_computed; }
 
    // Return an iterator to the begin of the alignment of the two sentences.
    Alignment::const_iterator
@@ -89,8 +142,9 @@ public:
    align_rend() const throw() { return alignment.rend(); }
 protected:
    Alignment alignment;
-   vector<vector<float> > matrix;
-   vector<Edit_operation*> operations;
+   Dp_buffer* buffer;
+   bool abandoned_flag;
+   long cells_computed;
 private:
 };
 
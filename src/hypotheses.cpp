@@ -0,0 +1,102 @@
+/******************************************************************************»
+ **
+ **   Filename    : hypotheses.cpp
+ **
+ **   Description : This file contains the implementation of the class
+ **                 Hypotheses, which turns the alignment of two trees into
+ **                 hypotheses (constituents) and inserts them into the
+ **                 trees.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#include "hypotheses.h"
+#include "nonterminal.h"
+
+using ns_edit_distance::SAME;
+using ns_edit_distance::DIFF;
+using ns_nonterminal::Nonterminal;
+
+namespace ns_hypotheses {
+
+void Hypotheses::insert(Tree* t, Constituent& c) throw() {
+   if (!(excl_empty && c.empty()) && c.valid()) {
+      int added=t->add_structure(c);
+      count += added;
+      merged += 1-added;
+   }
+}
+
+void Hypotheses::insert(Tree* t1, Tree* t2, Constituent& c1,
+  Constituent& c2) throw() {
+   if (!nomerge) {
+      Tree::struc_iterator c1pos=t1->find_structure(c1);
+      Tree::struc_iterator c2pos=t2->find_structure(c2);
+      if (c1pos != t1->struc_end()) {
+         if (c2pos != t2->struc_end()) { // merge
+            c1.push_back(*c2pos->begin());
+            c2.push_back(*c1pos->begin());
+            insert(t1,c1);
+            insert(t2,c2);
+         } else {
+            c2.push_back(*c1pos->begin());
+            insert(t2,c2);
+         }
+      } else {
+         if (c2pos != t2->struc_end()) {
+            c1.push_back(*c2pos->begin());
+            insert(t1,c1);
+         } else {
+            Nonterminal n=Nonterminal();
+            c1.push_back(n);
+            c2.push_back(n);
+            insert(t1,c1);
+            insert(t2,c2);
+         }
+      }
+   } else {
+      Nonterminal n=Nonterminal();
+      c1.push_back(n);
+      c2.push_back(n);
+      insert(t1,c1);
+      insert(t2,c2);
+   }
+}
+
+void Hypotheses::insert(Tree* t1, Tree* t2, Alignment::const_iterator a_b,
+  Alignment::const_iterator a_e) throw() {
+   if (a_b == a_e) { // two empty sentences
+      if (part_type == BOTH) {
+         Constituent c1=Constituent(0, 0);
+         Constituent c2=Constituent(0, 0);
+         insert(t1, t2, c1, c2);
+      }
+      return;
+   }
+   Alignment::const_iterator last=a_e-1;
+   for (Alignment::const_iterator s=a_b; s != last; ++s) {
+      if ((((part_type == BOTH)||(part_type == EQUAL))&&(s->kind == SAME))
+        ||(((part_type == BOTH)||(part_type == UNEQUAL))&&(s->kind == DIFF))) {
+         Constituent c1=Constituent(s->begin1, (s+1)->begin1);
+         Constituent c2=Constituent(s->begin2, (s+1)->begin2);
+         insert(t1, t2, c1, c2);
+      }
+   }
+   // Handle hypotheses at the end of the sentence
+   if ((part_type == BOTH)||((part_type == EQUAL)&&(last->kind == SAME))
+         ||((part_type == UNEQUAL)&&(last->kind == DIFF))) {
+      Constituent c1=Constituent(last->begin1, t1->size());
+      Constituent c2=Constituent(last->begin2, t2->size());
+      insert(t1, t2, c1, c2);
+   }
+}
+
+
+} // namespace
@@ -0,0 +1,71 @@
+/******************************************************************************»
+ **
+ **   Filename    : hypotheses.h
+ **
+ **   Description : This file contains the definition of the class
+ **                 Hypotheses, which turns the alignment of two trees into
+ **                 hypotheses (constituents) and inserts them into the
+ **                 trees. It is shared by abl_align and abl_merge, so a
+ **                 merged run inserts its hypotheses exactly like a single
+ **                 run.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __hypotheses__
+#define __hypotheses__
+
+#include "edit_distance.h"
+#include "constituent.h"
+#include "tree.h"
+
+using ns_constituent::Constituent;
+using ns_edit_distance::Alignment;
+using ns_tree::Tree;
+
+namespace ns_hypotheses {
+
+// Parts of the sentences that should be hypotheses.
+enum Part_type {EQUAL, UNEQUAL, BOTH};
+
+class Hypotheses {
+   // This class inserts hypotheses into trees and counts the new
+   // constituents and the hypotheses that were added to an existing one.
+   // When two trees get a hypothesis for the same pair of parts and one of
+   // the parts already is a constituent, the hypotheses share its
+   // nonterminal (unless merging is switched off).
+public:
+   Hypotheses() throw():part_type(UNEQUAL),nomerge(false),excl_empty(false),
+     count(0),merged(0) { }
+
+   Part_type part_type;  // parts of the sentences that are hypotheses
+   bool nomerge;         // do not try to merge hypotheses
+   bool excl_empty;      // do not insert hypotheses that span 0 words
+   int count;            // constituents that were inserted
+   long merged;          // hypotheses added to an existing constituent
+
+   // This procedure inserts c into t.
+   void insert(Tree* t, Constituent& c) throw();
+
+   // This procedure inserts c1 into t1 and c2 into t2 with the same
+   // nonterminal.
+   void insert(Tree* t1, Tree* t2, Constituent& c1, Constituent& c2) throw();
+
+   // This procedure inserts the hypotheses of the alignment a_b to a_e of
+   // t1 and t2. Each segment of the alignment, except the last, gives a
+   // pair of hypotheses that ends where the next segment begins.
+   void insert(Tree* t1, Tree* t2, Alignment::const_iterator a_b,
+     Alignment::const_iterator a_e) throw();
+};
+
+
+} // namespace
+
+#endif // __hypotheses__
@@ -0,0 +1,453 @@
+/******************************************************************************»
+ **
+ **   Filename    : merge.cpp
+ **
+ **   Description : This file implements the merging of the shards of the
+ **                 aligning phase. Every shard file (written by abl_align
+ **                 --shard) holds the alignments of part of the sentence
+ **                 pairs. The alignments of all shards are handled in the
+ **                 order of a single run of abl_align, which gives the
+ **                 same hypotheses and nonterminals.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include "constituent.h"
+#include "hypotheses.h"
+#include "nonterminal.h"
+#include "shard.h"
+#include "stats.h"
+#include "tools.h"
+#include "tree.h"
+#include "treebank.h"
+
+using namespace std;
+
+// configurable include files
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_GETOPT_H
+#define GNU_SOURCE
+#include <getopt.h>
+#else
+extern "C" {
+   char* optarg;
+   extern int optind, opterr, optopt;
+   struct option { const char *name; int has_arg; int *flag; int val;
+};
+#define no_argument            0
+#define required_argument      1
+#define optional_argument      2
+#ifdef HAVE_GETOPT_LONG_ONLY
+   extern int getopt_long_only (int argc, char * const argv[],
+           const char *optstring, const struct option *longopts, int
+           *longindex);
+#else
+
+#warning \
+Gnu Getopt Library not found: \
+cannot implement long option handling
+
+   extern int getopt(int argc, char* const argv[], const char*
+           optstring);
+   inline int getopt_long_only(int argc, char * const argv[],
+           const char *optstring, const struct option *longopts, int
+           *longindex) {
+        return getopt(argc, argv, optstring);
+   }
+#endif
+} // extern "C"
+#endif // #ifdef HAVE_GETOPT_H #else
+
+
+using ns_constituent::Constituent;
+using ns_hypotheses::Hypotheses;
+using ns_nonterminal::Nonterminal;
+using ns_shard::Event;
+using ns_shard::Event_reader;
+using ns_shard::fingerprint;
+using ns_shard::Shard_header;
+using ns_tree::Tree;
+using ns_treebank::Treebank;
+using ns_tools::error;
+using ns_tools::warning;
+using ns_tools::debug;
+using ns_tools::getDate;
+using ns_stats::Histogram;
+using ns_stats::Stats;
+
+static struct option long_options[] = {
+   {"debug", no_argument, 0, 'd'},
+   {"help", no_argument, 0, 'h'},
+   {"input", required_argument, 0, 'i'},
+   {"output", required_argument, 0, 'o'},
+   {"stats", required_argument, 0, 'T'},
+   {"verbose", no_argument, 0, 'v'},
+   {"version", no_argument, 0, 'V'},
+   {0, 0, 0, 0}
+};
+
+// Input stream (defaults to cin).
+istream *ifs=&cin;
+// Output stream (defaults to cout).
+ostream *ofs=&cout;
+// Name of the program as it was called.
+string program_name;
+// Print debug information.
+bool debug_flag=false;
+// Print process information
+bool verbose_flag=false;
+// Figures of the run and the file they are written to (empty means none)
+Stats stats;
+string stats_file;
+// 0 is the startsymbol (initial nonterminal type).
+const int startsymbol=0;
+// Names of the shard files.
+vector<string> shard_names;
+// Inserts the hypotheses (with the settings of the shards).
+Hypotheses hypotheses;
+// Counters of the sentence pairs that are abandoned, and that the shards
+// left out because they change nothing
+long abandoned_cnt=0;
+long left_out_cnt=0;
+
+void
+usage() {
+   cerr << "ABL " << VERSION << endl;
+   cerr << "Alignment-Based Learner" << endl;
+   cerr << __DATE__ << " " << __TIME__ << "\n" << endl;
+   cerr << "Usage:" << program_name;
+   cerr << " [OPTION]... SHARD..." << endl;
+   cerr << "This program merges the shard files written by abl_align ";
+   cerr << "--shard into the" << endl;
+   cerr << "treebank that a single run of abl_align on the input file ";
+   cerr << "would produce." << endl;
+   cerr << "All shards of the run should be given." << endl;
+   cerr << endl;
+#ifndef HAVE_GETOPT_H
+   cerr << "<BEGIN WARNING>" << endl;
+   cerr << "This program has been compiled without the long options ";
+   cerr << "installed." << endl;
+   cerr << "This means that none of the --options work." << endl;
+   cerr << "<END WARNING>" << endl;
+   cerr << endl;
+#endif // #ifndef HAVE_GETOPT_H
+   cerr << "  -i, --input=FILE   ";
+   cerr << "Name of input file (- means stdin, default)" << endl;
+   cerr << "  -o, --output=FILE  ";
+   cerr << "Name of output file (- means stdout, default)" << endl;
+   cerr << "  -d, --debug        ";
+   cerr << "Output debug information" << endl;
+   cerr << "  -T, --stats=FILE   ";
+   cerr << "Write the timing of the phases and the counters of the run" << endl;
+   cerr << "                     ";
+   cerr << "to FILE (in JSON)" << endl;
+   cerr << "  -h, --help         ";
+   cerr << "Show this help and exit" << endl;
+   cerr << "  -v, --verbose      ";
+   cerr << "Show details about the merging process" << endl;
+   cerr << "  -V, --version      ";
+   cerr << "Show version information and exit" << endl;
+   exit(0);
+}
+
+void
+handle_arguments(int argc, char* argv[]) {
+   int opt;
+   int option_index;
+   const char* optstring="dhi:o:T:vV";
+   program_name=argv[0];
+   bool input_ok=false,output_ok=false;
+   while ((opt=getopt_long_only(argc,argv,optstring,long_options,&option_index))
+           !=-1){
+      switch (opt) {
+         case 'd':
+            debug_flag=true;
+            break;
+         case 'h':
+            usage();
+            break;
+         case 'i':
+            if (strcmp(optarg, "-")!=0) {
+               if (input_ok) {
+                  delete ifs;
+               }
+               ifs=new ifstream(optarg);
+               if (!ifs->good()) {
+                  error(program_name, string("cannot open input file ")+optarg);
+               }
+               input_ok=true;
+            }
+            break;
+         case 'o':
+            if (strcmp(optarg, "-") != 0) {
+               if (output_ok) {
+                  delete ofs;
+               }
+               ofs=new ofstream(optarg);
+               if (!ofs->good()) {
+                  error(program_name,string("cannot open output file ")+optarg);
+               }
+               output_ok=true;
+            }
+            break;
+         case 'T':
+            stats_file=optarg;
+            break;
+         case 'v':
+            verbose_flag = true;
+            break;
+         case 'V':
+            cout << "merge ("<< PACKAGE << ") version " << VERSION << endl;
+            exit(0);
+            break;
+         case '?': // ambiguous match or extraneous parameter
+            usage();
+            break;
+         default:
+            error(program_name, "internal getopt error");
+            usage();
+      }
+   }
+   for (; optind < argc; optind++) {
+      shard_names.push_back(argv[optind]);
+   }
+   if (shard_names.empty()) {
+      error(program_name, "No shard files supplied.");
+      usage();
+   }
+}
+
+struct Shard {
+   // This class reads the events of a shard file one by one. done is set
+   // after the last event.
+   Shard(const string& n):name(n),is(n.c_str()),reader(is),done(false) { }
+
+   // This procedure reads the next event. A shard without its end line
+   // was cut off.
+   void next() {
+      if (!reader.read(event)) {
+         if (!reader.ended) {
+            error(program_name, string("malformed or truncated shard ")+name);
+         }
+         abandoned_cnt+=reader.abandoned;
+         left_out_cnt+=reader.left_out;
+         done=true;
+      }
+   }
+
+   string name;
+   ifstream is;
+   Event_reader reader;
+   Shard_header header;
+   Event event;
+   bool done;
+};
+
+// This procedure opens the shard files and checks that they belong
+// together: all shards of the same run, each of them once.
+void open_shards(vector<Shard*>& shards) {
+   for (vector<string>::const_iterator n=shard_names.begin();
+     n != shard_names.end(); ++n) {
+      Shard* s=new Shard(*n);
+      if (!s->is.good()) {
+         error(program_name, string("cannot open shard file ")+*n);
+      }
+      if (!s->header.read(s->is)) {
+         error(program_name, string("not a shard file ")+*n);
+      }
+      shards.push_back(s);
+   }
+   const Shard_header& h=shards.front()->header;
+   vector<bool> seen(h.shards, false);
+   for (vector<Shard*>::const_iterator s=shards.begin(); s != shards.end();
+     ++s) {
+      string d=h.differs((*s)->header);
+      if (!d.empty()) {
+         error(program_name, "shard of another run (different "+d+") "
+           +(*s)->name);
+      }
+      if (seen[(*s)->header.shard-1]) {
+         error(program_name, string("shard given twice ")+(*s)->name);
+      }
+      seen[(*s)->header.shard-1]=true;
+   }
+   if (int(shards.size()) != h.shards) {
+      error(program_name, "not all shards supplied");
+   }
+   hypotheses.part_type=h.part_type;
+   hypotheses.nomerge=h.nomerge;
+   hypotheses.excl_empty=h.excl_empty;
+}
+
+// This procedure handles the events of all shards in the order of a
+// single run: the sentences one by one, each with its later sentences in
+// increasing order. Every shard file is in that order already, so the
+// shards are merged like sorted lists.
+void merge(Treebank& tb, vector<Shard*>& shards) {
+   for (vector<Shard*>::iterator s=shards.begin(); s != shards.end(); ++s) {
+      (*s)->next();
+   }
+   Nonterminal start(startsymbol);
+   for (int i=0; i<int(tb.size()); i++) {
+      debug(program_name, debug_flag, "Merging sentence", i);
+      Constituent c=Constituent(0, tb[i].size());
+      c.push_back(start);
+      hypotheses.count += tb[i].add_structure(c);
+      for (;;) {
+         Shard* first=0;
+         for (vector<Shard*>::iterator s=shards.begin(); s != shards.end();
+           ++s) {
+            if (!(*s)->done&&((*s)->event.first == i)&&((first == 0)
+              ||((*s)->event.second < first->event.second))) {
+               first=*s;
+            }
+         }
+         if (first == 0) {
+            break;
+         }
+         const Event& e=first->event;
+         if ((e.second <= i)||(e.second >= int(tb.size()))) {
+            error(program_name, string("event out of range in ")+first->name);
+         }
+         Tree* t1=&tb[e.reversed?e.second:i];
+         Tree* t2=&tb[e.reversed?i:e.second];
+         if (!e.fits(t1->size(), t2->size())) {
+            error(program_name, string("event out of range in ")+first->name);
+         }
+         first->event.complete(t1->size(), t2->size());
+         hypotheses.insert(t1, t2, e.alignment.begin(), e.alignment.end());
+         first->next();
+      }
+   }
+   for (vector<Shard*>::iterator s=shards.begin(); s != shards.end(); ++s) {
+      if (!(*s)->done) {
+         error(program_name, string("events out of order in ")+(*s)->name);
+      }
+   }
+}
+
+void read_treebank(Treebank& tb) {
+   *ifs >> tb;
+}
+
+void write_treebank(const Treebank& tb) {
+   *ofs << tb;
+}
+
+void outit() {
+   if (ifs != &cin){
+      delete ifs;
+   }
+   if (ofs != &cout) {
+      delete ofs;
+   }
+}
+
+void write_infoheader(const Treebank& tb, char** args, int& argsc, int& c) {
+
+   *ofs << "# " << setiosflags(ios::left) << setw(14) << program_name
+      << " :: " << setiosflags(ios::left) << setw(16) << "execution time"
+      << " :: " << getDate();
+   *ofs << "# " << setiosflags(ios::left) << setw(14) <<  program_name
+      << " :: " << setiosflags(ios::left) << setw(16) << "command call"
+      << " :: ";
+
+   for(int i=0; i<argsc;i++) {
+      *ofs << args[i] << " ";
+   }
+   *ofs << "\n";
+
+   *ofs << "# " << setiosflags(ios::left) << setw(14) << program_name
+      << " :: " << setiosflags(ios::left) << setw(16) << "hyps generated"
+      << " :: " << c << "\n";
+
+   for (unsigned int i=0; i < tb.comments.size(); i++) {
+      *ofs << tb.comments.at(i) << endl;
+   }
+}
+
+// This procedure writes the statistics of the run to the stats file.
+void write_stats(const Treebank& tb, int argc, char* argv[]) {
+   stats.end();
+   stats.set("sentences", tb.size());
+   stats.set("shards", shard_names.size());
+   stats.set("pairs_abandoned", abandoned_cnt);
+   stats.set("pairs_left_out", left_out_cnt);
+   stats.set("hypotheses_inserted", hypotheses.count);
+   // leaves out the hypotheses of the pairs that change nothing
+   stats.set("hypotheses_merged", hypotheses.merged);
+   Histogram& lengths=stats.histogram("sentence_length");
+   for (Treebank::const_iterator t=tb.begin(); t != tb.end(); ++t) {
+      lengths.add(t->size());
+   }
+   if (!stats.write(stats_file, program_name, argc, argv)) {
+      warning(program_name, "cannot write statistics to "+stats_file);
+   }
+}
+
+int main(int argc, char* argv[]) {
+   const clock_t startTime = clock();
+   handle_arguments(argc, argv);
+   stats.begin("read");
+   vector<Shard*> shards;
+   open_shards(shards);
+   const Shard_header& h=shards.front()->header;
+   Treebank tb;
+   read_treebank(tb);
+   if (verbose_flag) {
+      cerr << program_name << "  : # sentences loaded            : "
+         << tb.size() << endl;
+   }
+   Treebank all;         // all trees while the treebank is collapsed
+   vector<int> copies;   // distinct sentence of every tree
+   if (h.collapse) {
+      tb.collapse(all, copies);
+   }
+   if ((int(tb.size()) != h.sentences)
+     ||(fingerprint(tb.begin(), tb.end()) != h.fingerprint)) {
+      error(program_name, "the shards belong to another input file");
+   }
+   stats.begin("merge");
+   merge(tb, shards);
+   if (h.collapse) {
+      tb.expand(all, copies);
+   }
+   for (vector<Shard*>::iterator s=shards.begin(); s != shards.end(); ++s) {
+      delete *s;
+   }
+   stats.begin("write");
+   write_infoheader(tb, argv, argc, hypotheses.count);
+   write_treebank(tb);
+   outit();
+   if (verbose_flag) {
+      cerr << program_name << "  : # shards merged               : "
+         << h.shards << endl;
+      cerr << program_name << "  : # hypotheses generated        : "
+         << hypotheses.count << endl;
+      cerr << program_name << "  : # sentence pairs abandoned    : "
+         << abandoned_cnt << endl;
+      cerr << program_name << "  : # seconds execution time      : "
+         << (double)(clock()-startTime)/CLOCKS_PER_SEC << endl;
+   }
+   if (!stats_file.empty()) {
+      write_stats(tb, argc, argv);
+   }
+   return 0;
+}
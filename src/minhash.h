@@ -0,0 +1,250 @@
+/******************************************************************************»
+ **
+ **   Filename    : minhash.h
+ **
+ **   Description : This file contains the definition of the class Lsh,
+ **                 which finds similar sentences with locality sensitive
+ **                 hashing. Every sentence is described by its shingles
+ **                 (sequences of shingle words, or the whole sentence if
+ **                 it is shorter). A MinHash signature of bands*rows
+ **                 values is computed for the shingles and every band of
+ **                 rows values is hashed into a bucket. Sentences that
+ **                 share a bucket in at least one band are candidates. Two
+ **                 sentences with Jaccard similarity J (of their sets of
+ **                 shingles) share a bucket with probability
+ **                 1-(1-J^rows)^bands.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __minhash__
+#define __minhash__
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace ns_minhash {
+
+using ns_thread_pool::Task;
+using ns_thread_pool::Thread_pool;
+
+// This procedure scrambles the bits of x (the finalizer of splitmix64).
+inline uint64_t mix(uint64_t x) throw() {
+   x+=0x9e3779b97f4a7c15ULL;
+   x=(x^(x >> 30))*0xbf58476d1ce4e5b9ULL;
+   x=(x^(x >> 27))*0x94d049bb133111ebULL;
+   return x^(x >> 31);
+}
+
+class Lsh {
+public:
+   Lsh() throw():bands(20),rows(5),shingle(1),found(0),first(0),pass(0),
+     epoch(0) { }
+
+   int bands;    // number of bands of the signature
+   int rows;     // number of values in a band
+   int shingle;  // number of words in a shingle
+   long found;   // pairs that share a bucket
+
+   // Return the Jaccard similarity at which pairs become likely to share
+   // a bucket.
+   double threshold() const throw() {
+      return pow(1.0/bands, 1.0/rows);
+   }
+
+   // Return the probability that a pair with Jaccard similarity j shares a
+   // bucket.
+   double recall(const double j) const throw() {
+      return 1-pow(1-pow(j, rows), bands);
+   }
+
+   // This procedure puts the sentences b to e-1 (sentence i is b+i) in
+   // buckets. The bands are built in passes of one band for each thread of
+   // pool. In a pass the hashes of the bands are computed, a chunk of
+   // sentences at a time, and every band is sorted into buckets, so only
+   // the hashes of one pass are held at a time. A band keeps only the
+   // sentences that share a bucket.
+   template <class Ran>
+   void build(Ran b, Ran e, Thread_pool& pool) {
+      size=e-b;
+      seeds.clear();
+      for (int f=0; f<bands*rows; f++) {
+         seeds.push_back(mix(f+1));
+      }
+      blank.assign(size, 1);
+      buckets.assign(bands, Band());
+      for (first=0; first<bands; first+=pass) {
+         pass=min(pool.size(), bands-first);
+         keys.assign(size_t(pass)*size, 0);
+         Signature_task<Ran> signatures(*this, b, pool.size());
+         pool.run(signatures, (size+chunk-1)/chunk);
+         Bucket_task bucketing(*this);
+         pool.run(bucketing, pass);
+      }
+      vector<uint64_t>().swap(keys);
+      vector<char>().swap(blank);
+      visited.assign(size, 0);
+      epoch=0;
+   }
+
+   // This procedure stores in result the sentences after sentence i, and
+   // from sentence from onwards, that share a bucket with it, in
+   // increasing order.
+   void later(const int i, vector<int>& result, const int from=0) {
+      result.clear();
+      if (++epoch == 0) { // the marks wrapped around
+         visited.assign(visited.size(), 0);
+         epoch=1;
+      }
+      for (vector<Band>::const_iterator band=buckets.begin();
+        band != buckets.end(); ++band) {
+         vector<pair<int, int> >::const_iterator s=lower_bound(
+           band->bucket.begin(), band->bucket.end(), make_pair(i, -1));
+         if ((s == band->bucket.end())||(s->first != i)) {
+            continue;
+         }
+         int k=s->second;
+         vector<int>::const_iterator p_e=band->members.begin()
+           +band->offsets[k+1];
+         vector<int>::const_iterator p=upper_bound(band->members.begin()
+           +band->offsets[k], p_e, max(i, from-1));
+         for (; p != p_e; ++p) {
+            if (visited[*p] != epoch) {
+               visited[*p]=epoch;
+               result.push_back(*p);
+            }
+         }
+      }
+      found+=result.size();
+      sort(result.begin(), result.end());
+   }
+
+private:
+   enum { chunk=1024 }; // sentences of a signature job
+
+   struct Band {
+      // This class holds the buckets of a band with more than one
+      // sentence: the sentences in them with their bucket (in increasing
+      // order of the sentences) and the sentences of bucket k (members
+      // offsets[k] to offsets[k+1]-1, increasing).
+      vector<pair<int, int> > bucket;
+      vector<int> offsets;
+      vector<int> members;
+   };
+
+   template <class Ran>
+   class Signature_task:public Task {
+      // A job computes the hashes of the bands of the pass of a chunk of
+      // sentences.
+   public:
+      Signature_task(Lsh& l, Ran b, const int threads)
+        :lsh(l),begin(b),mins(threads) { }
+
+      void run(const int job, const int thread) {
+         vector<uint64_t>& m=mins[thread];
+         int n=lsh.pass*lsh.rows;
+         vector<uint64_t>::const_iterator seeds=lsh.seeds.begin()
+           +lsh.first*lsh.rows;
+         int last=min(lsh.size, (job+1)*int(chunk));
+         for (int i=job*chunk; i<last; i++) {
+            const typename Ran::value_type& s=*(begin+i);
+            if (s.empty()) {
+               continue;
+            }
+            lsh.blank[i]=0;
+            m.assign(n, ~uint64_t(0));
+            int width=min(int(s.size()), lsh.shingle);
+            for (int w=0; w+width <= int(s.size()); w++) {
+               uint64_t h=0;
+               for (int x=w; x<w+width; x++) {
+                  h=mix(h^uint64_t(s[x].getIdx()));
+               }
+               for (int f=0; f<n; f++) {
+                  m[f]=min(m[f], mix(h^seeds[f]));
+               }
+            }
+            for (int band=0; band<lsh.pass; band++) {
+               uint64_t key=mix(lsh.first+band);
+               for (int r=0; r<lsh.rows; r++) {
+                  key=mix(key^m[band*lsh.rows+r]);
+               }
+               lsh.keys[size_t(band)*lsh.size+i]=key;
+            }
+         }
+      }
+
+   private:
+      Lsh& lsh;
+      Ran begin;
+      vector<vector<uint64_t> > mins; // signature of each thread
+   };
+
+   class Bucket_task:public Task {
+      // A job sorts the sentences of a band of the pass by their hash and
+      // keeps the buckets with more than one sentence.
+   public:
+      Bucket_task(Lsh& l):lsh(l) { }
+
+      void run(const int job, const int thread) {
+         Band& band=lsh.buckets[lsh.first+job];
+         vector<uint64_t>::const_iterator k=lsh.keys.begin()
+           +size_t(job)*lsh.size;
+         vector<pair<uint64_t, int> > order;
+         for (int i=0; i<lsh.size; i++) {
+            if (!lsh.blank[i]) {
+               order.push_back(make_pair(k[i], i));
+            }
+         }
+         sort(order.begin(), order.end());
+         band.offsets.push_back(0);
+         for (size_t b=0; b<order.size(); ) {
+            size_t e=b+1;
+            while ((e < order.size())&&(order[e].first == order[b].first)) {
+               e++;
+            }
+            if (e-b > 1) {
+               for (size_t p=b; p<e; p++) {
+                  band.bucket.push_back(make_pair(order[p].second,
+                    int(band.offsets.size())-1));
+                  band.members.push_back(order[p].second);
+               }
+               band.offsets.push_back(band.members.size());
+            }
+            b=e;
+         }
+         sort(band.bucket.begin(), band.bucket.end());
+      }
+
+   private:
+      Lsh& lsh;
+   };
+
+   int size;                     // number of sentences
+   vector<uint64_t> seeds;       // one for each value of the signature
+   int first;                    // first band of the pass
+   int pass;                     // number of bands of the pass
+   vector<uint64_t> keys;        // hash of band first+b of sentence i:
+                                 // b*size+i
+   vector<char> blank;           // sentences without words (no signature)
+   vector<Band> buckets;         // one for each band
+   vector<unsigned int> visited; // last epoch that found each sentence
+   unsigned int epoch;
+};
+
+
+} // namespace
+
+#endif // __minhash__
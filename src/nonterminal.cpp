@@ -38,7 +38,7 @@ void Nonterminal::read(istream& is) throw() {
    }
    is.unget();
    is >> value;
-   if (value >= upper_nt) upper_nt=value;
+   if (value >= upper_nt) upper_nt=value+1;
 }
 
 ostream& operator<<(ostream& os, const Nonterminal& n) {
@@ -57,6 +57,14 @@ public:
       return value == n.value;
    }
 
+   // The number of the nonterminal and the number the next new
+   // nonterminal gets (used to save and restore a run).
+   unsigned long number() const throw() { return value; }
+   static unsigned long next_number() throw() { return upper_nt; }
+   static void set_next_number(const unsigned long n) throw() {
+      upper_nt=n;
+   }
+
 private:
 
    operator unsigned long() const { return value; }
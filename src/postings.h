@@ -0,0 +1,198 @@
+/******************************************************************************»
+ **
+ **   Filename    : postings.h
+ **
+ **   Description : This file contains the definition of the class
+ **                 Postings, an inverted index from words to the
+ **                 sentences they occur in. The postings of all words are
+ **                 stored in one array (compressed sparse rows), every
+ **                 sentence at most once per word and in the order of the
+ **                 treebank. The index is used to find the later sentences
+ **                 that have a word in common with a sentence. A
+ **                 Candidate_policy can ignore frequent words and ask for
+ **                 a minimum number of distinct shared words.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __postings__
+#define __postings__
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace ns_postings {
+
+struct Candidate_policy {
+   // This class holds the rules that decide which sentences with words in
+   // common are candidates and counts what the rules did. Words that occur
+   // in more than max_frequency percent of the sentences are ignored and
+   // candidates share at least min_shared distinct other words. Repeated
+   // words count once: "the the" and "the the" share one word (unlike the
+   // overlap of the Overlap_filter, which is 2).
+   //
+   // The pairs that share only ignored words are counted if count_frequent
+   // is set. This walks the postings of the ignored words, which the
+   // policy otherwise skips, so it is only done for the statistics.
+   Candidate_policy() throw():max_frequency(100),min_shared(1),
+     count_frequent(false),frequent_words(0),skipped_postings(0),found(0),
+     frequent_only(0),too_few_shared(0) { }
+   double max_frequency;
+   int min_shared;
+   bool count_frequent;
+   int frequent_words;     // words that are ignored
+   long skipped_postings;  // later sentences passed over for ignored words
+   long found;             // pairs that share a word that is not ignored
+   long frequent_only;     // pairs dropped as they share only ignored words
+   long too_few_shared;    // pairs dropped with fewer than min_shared words
+};
+
+class Postings {
+public:
+   Postings() throw():max_postings(0),epoch(0) { }
+
+   Candidate_policy policy;
+
+   // This procedure builds the index of the sentences b to e-1 (sentence
+   // i is b+i). Words are identified by their index (getIdx).
+   template <class Ran>
+   void build(Ran b, Ran e) {
+      int words=0;
+      for (Ran s=b; s != e; ++s) {
+         for (typename Ran::value_type::const_iterator w=s->begin();
+           w != s->end(); ++w) {
+            words=max(words, w->getIdx()+1);
+         }
+      }
+      vector<int> last(words, -1); // last sentence counted for a word
+      offsets.assign(words+1, 0);
+      for (Ran s=b; s != e; ++s) {
+         int i=s-b;
+         for (typename Ran::value_type::const_iterator w=s->begin();
+           w != s->end(); ++w) {
+            if (last[w->getIdx()] != i) {
+               last[w->getIdx()]=i;
+               offsets[w->getIdx()+1]++;
+            }
+         }
+      }
+      for (int w=0; w<words; w++) {
+         offsets[w+1]+=offsets[w];
+      }
+      sentences.resize(offsets[words]);
+      vector<int> fill(offsets.begin(), offsets.end()-1);
+      last.assign(words, -1);
+      for (Ran s=b; s != e; ++s) {
+         int i=s-b;
+         for (typename Ran::value_type::const_iterator w=s->begin();
+           w != s->end(); ++w) {
+            if (last[w->getIdx()] != i) {
+               last[w->getIdx()]=i;
+               sentences[fill[w->getIdx()]++]=i;
+            }
+         }
+      }
+      max_postings=policy.max_frequency*(e-b)/100;
+      policy.frequent_words=0;
+      for (int w=0; w<words; w++) {
+         if (offsets[w+1]-offsets[w] > max_postings) {
+            policy.frequent_words++;
+         }
+      }
+      visited.assign(e-b, 0);
+      shared.assign(e-b, 0);
+      epoch=0;
+   }
+
+   // This procedure stores in result the sentences after sentence i (with
+   // the words s), and from sentence from onwards, that are candidates
+   // according to the policy, in increasing order. A sentence that is
+   // found is marked with the number of the call (epoch) instead of being
+   // collected in a set, so the marks need not be cleared.
+   template <class Sen>
+   void later(const int i, const Sen& s, vector<int>& result,
+     const int from=0) {
+      result.clear();
+      if (++epoch == 0) { // the marks wrapped around
+         visited.assign(visited.size(), 0);
+         epoch=1;
+      }
+      words.clear();
+      for (typename Sen::const_iterator w=s.begin(); w != s.end(); ++w) {
+         words.push_back(w->getIdx());
+      }
+      sort(words.begin(), words.end());
+      words.erase(unique(words.begin(), words.end()), words.end());
+      vector<int>::const_iterator all=sentences.begin();
+      frequent.clear();
+      for (vector<int>::const_iterator w=words.begin(); w != words.end();
+        ++w) {
+         vector<int>::const_iterator p_e=all+offsets[*w+1];
+         vector<int>::const_iterator p=upper_bound(all+offsets[*w], p_e,
+           max(i, from-1));
+         if (offsets[*w+1]-offsets[*w] > max_postings) {
+            policy.skipped_postings+=p_e-p;
+            if (policy.count_frequent) {
+               frequent.push_back(make_pair(p-all, p_e-all));
+            }
+            continue;
+         }
+         for (; p != p_e; ++p) {
+            if (visited[*p] != epoch) {
+               visited[*p]=epoch;
+               shared[*p]=1;
+               result.push_back(*p);
+            } else {
+               shared[*p]++;
+            }
+         }
+      }
+      for (vector<pair<int, int> >::const_iterator f=frequent.begin();
+        f != frequent.end(); ++f) {
+         for (int p=f->first; p<f->second; p++) {
+            if (visited[sentences[p]] != epoch) {
+               visited[sentences[p]]=epoch;
+               policy.frequent_only++;
+            }
+         }
+      }
+      policy.found+=result.size();
+      if (policy.min_shared > 1) {
+         vector<int>::iterator kept=result.begin();
+         for (vector<int>::const_iterator r=result.begin(); r != result.end();
+           ++r) {
+            if (shared[*r] >= policy.min_shared) {
+               *kept++=*r;
+            }
+         }
+         policy.too_few_shared+=result.end()-kept;
+         result.erase(kept, result.end());
+      }
+      sort(result.begin(), result.end());
+   }
+
+private:
+   vector<int> offsets;          // postings of w: offsets[w] to offsets[w+1]-1
+   vector<int> sentences;        // the postings of all words
+   double max_postings;          // longer postings belong to ignored words
+   vector<unsigned int> visited; // last epoch that found each sentence
+   vector<int> shared;           // words shared with the sentence (if found)
+   unsigned int epoch;
+   vector<int> words;            // distinct words of the sentence
+   vector<pair<int, int> > frequent; // later postings of ignored words
+};
+
+
+} // namespace
+
+#endif // __postings__
@@ -0,0 +1,168 @@
+/******************************************************************************»
+ **
+ **   Filename    : prefilter.h
+ **
+ **   Description : This file contains the prefilters of sentence pairs.
+ **                 Before a pair of sentences is aligned, a chain of
+ **                 prefilters looks at cheap properties of the pair (the
+ **                 lengths and the words the sentences have in common)
+ **                 and may reject it. Length_filter and Bag_filter use
+ **                 lower bounds on the edit cost, so they only reject
+ **                 pairs that would be abandoned by the maximum edit
+ **                 distance anyway. Overlap_filter rejects pairs that
+ **                 have too few words in common, which changes the
+ **                 hypotheses that are found.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __prefilter__
+#define __prefilter__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ns_prefilter {
+
+// A bag of words is the sorted list of word indices of a sentence.
+typedef vector<int> Bag;
+
+class Pair_summary {
+   // This class describes a sentence pair by what the prefilters need: the
+   // lengths of the sentences and the number of words they have in common
+   // (counted with multiplicity). The overlap is only computed when a
+   // filter asks for it.
+public:
+   Pair_summary(const Bag& b1, const Bag& b2) throw()
+     :bag1(b1),bag2(b2),overlap_cnt(-1) { }
+
+   int length1() const throw() { return bag1.size(); }
+   int length2() const throw() { return bag2.size(); }
+
+   int overlap() const throw() {
+      if (overlap_cnt < 0) {
+         overlap_cnt=0;
+         Bag::const_iterator i=bag1.begin(), j=bag2.begin();
+         while ((i != bag1.end())&&(j != bag2.end())) {
+            if (*i < *j) {
+               ++i;
+            } else if (*j < *i) {
+               ++j;
+            } else {
+               overlap_cnt++;
+               ++i; ++j;
+            }
+         }
+      }
+      return overlap_cnt;
+   }
+private:
+   const Bag& bag1;
+   const Bag& bag2;
+   mutable int overlap_cnt;
+};
+
+class Prefilter {
+   // This is the base class of the prefilters. It counts the pairs it
+   // rejected.
+public:
+   Prefilter(const string& n) throw():name(n),removed(0) { }
+   virtual ~Prefilter() { }
+
+   // Return true if the pair should not be aligned.
+   virtual bool reject(const Pair_summary& p) const throw()=0;
+
+   string name;
+   long removed;
+};
+
+class Length_filter:public Prefilter {
+   // Every word that has no counterpart costs at least 1, so the edit cost
+   // of a pair is at least the difference in length.
+public:
+   Length_filter(const float d) throw()
+     :Prefilter("length difference"),max_distance(d) { }
+   bool reject(const Pair_summary& p) const throw() {
+      return abs(p.length1()-p.length2()) > max_distance;
+   }
+private:
+   float max_distance;
+};
+
+class Bag_filter:public Prefilter {
+   // Only words that occur in both sentences can be linked, so the edit
+   // cost is at least the number of words outside the overlap.
+public:
+   Bag_filter(const float d) throw()
+     :Prefilter("bag of words"),max_distance(d) { }
+   bool reject(const Pair_summary& p) const throw() {
+      return p.length1()+p.length2()-2*p.overlap() > max_distance;
+   }
+private:
+   float max_distance;
+};
+
+class Overlap_filter:public Prefilter {
+   // Pairs with fewer words in common than min_overlap are rejected. This
+   // drops the hypotheses around a single shared word.
+public:
+   Overlap_filter(const int m) throw()
+     :Prefilter("minimum overlap"),min_overlap(m) { }
+   bool reject(const Pair_summary& p) const throw() {
+      return p.overlap() < min_overlap;
+   }
+private:
+   int min_overlap;
+};
+
+class Prefilter_chain {
+   // This class applies its prefilters in the order in which they were
+   // added. A rejected pair is counted by the first filter that rejects
+   // it. The chain owns the filters.
+public:
+   typedef vector<Prefilter*>::const_iterator const_iterator;
+
+   Prefilter_chain() throw() { }
+   ~Prefilter_chain() {
+      for (const_iterator f=filters.begin(); f != filters.end(); ++f) {
+         delete *f;
+      }
+   }
+
+   void add(Prefilter* f) { filters.push_back(f); }
+   bool empty() const throw() { return filters.empty(); }
+
+   // Return true if none of the filters rejects the pair.
+   bool pass(const Pair_summary& p) throw() {
+      for (const_iterator f=filters.begin(); f != filters.end(); ++f) {
+         if ((*f)->reject(p)) {
+            (*f)->removed++;
+            return false;
+         }
+      }
+      return true;
+   }
+
+   const_iterator begin() const throw() { return filters.begin(); }
+   const_iterator end() const throw() { return filters.end(); }
+private:
+   Prefilter_chain(const Prefilter_chain&);
+   Prefilter_chain& operator=(const Prefilter_chain&);
+
+   vector<Prefilter*> filters;
+};
+
+
+} // namespace
+
+#endif // __prefilter__
@@ -24,6 +24,7 @@
 #include "constituent.h"
 #include "nonterminal.h"
 #include "sentence.h"
+#include "stats.h"
 #include "tools.h"
 #include "tree.h"
 #include "treebank.h"
@@ -80,6 +81,8 @@ using ns_tools::error;
 using ns_tools::warning;
 using ns_tools::debug;
 using ns_tools::getDate;
+using ns_stats::Histogram;
+using ns_stats::Stats;
 
 static struct option long_options[] = {
    {"debug", no_argument, 0, 'd'},
@@ -88,6 +91,7 @@ static struct option long_options[] = {
    {"output", required_argument, 0, 'o'},
    {"preserve_mem", no_argument, 0, 'm'},
    {"select", required_argument, 0, 's'},
+   {"stats", required_argument, 0, 'T'},
    {"verbose", no_argument, 0, 'v'},
    {"version", no_argument, 0, 'V'},
    {0, 0, 0, 0}
@@ -109,6 +113,9 @@ string program_name;
 bool debug_flag=false;
 // Print process information
 bool verbose_flag=false;
+// Figures of the run and the file they are written to (empty means none)
+Stats stats;
+string stats_file;
 // Count number of initial hypotheses
 int hyps_cnt=0;
 // Count selected constituents
@@ -164,6 +171,10 @@ usage() {
    cerr << "Preserves memory use (and is slower)." << endl;
    cerr << "  -d, --debug        ";
    cerr << "Output debug information" << endl;
+   cerr << "  -T, --stats=FILE   ";
+   cerr << "Write the timing of the phases and the counters of the run" << endl;
+   cerr << "                     ";
+   cerr << "to FILE (in JSON)" << endl;
    cerr << "  -h, --help         ";
    cerr << "Show this help and exit" << endl;
    cerr << "  -v, --verbode      ";
@@ -177,7 +188,7 @@ void
 handle_arguments(int argc, char* argv[]) {
    int opt;
    int option_index;
-   const char* optstring="dhi:mo:s:v";
+   const char* optstring="dhi:mo:s:T:v";
    program_name=argv[0];
    bool input_ok=false,output_ok=false;
    while ((opt=getopt_long_only(argc,argv,optstring,long_options,&option_index))
@@ -235,6 +246,9 @@ handle_arguments(int argc, char* argv[]) {
                usage();
             }
             break;
+         case 'T':
+            stats_file=optarg;
+            break;
          case 'v':
             verbose_flag = true;
             break;
@@ -578,16 +592,34 @@ void write_infoheader(const Treebank& tb, char** args, int& argsc, int& c, int&
 }
 
 
+// This procedure writes the statistics of the run to the stats file.
+void write_stats(const Treebank& tb, int argc, char* argv[]) {
+   stats.end();
+   stats.set("sentences", tb.size());
+   stats.set("hypotheses_loaded", hyps_cnt);
+   stats.set("hypotheses_selected", consts_cnt);
+   Histogram& lengths=stats.histogram("sentence_length");
+   for (Treebank::const_iterator t=tb.begin(); t != tb.end(); ++t) {
+      lengths.add(t->size());
+   }
+   if (!stats.write(stats_file, program_name, argc, argv)) {
+      warning(program_name, "cannot write statistics to "+stats_file);
+   }
+}
+
 int main(int argc, char* argv[]) {
    const clock_t startTime = clock();
    handle_arguments(argc, argv);
+   stats.begin("read");
    Treebank tb;
    read_treebank(tb);
+   stats.begin("select");
    select(&tb);
    if (verbose_flag) {
       cerr << program_name << " : # sentences loaded            : "
          << tb.size() << endl;
    }
+   stats.begin("write");
    write_infoheader(tb,argv,argc,hyps_cnt,consts_cnt);
    write_treebank(tb);
    outit();
@@ -599,5 +631,8 @@ int main(int argc, char* argv[]) {
      cerr << program_name << " : # seconds execution time      : "
          << (double)(clock()-startTime)/CLOCKS_PER_SEC << endl;
    }
+   if (!stats_file.empty()) {
+      write_stats(tb, argc, argv);
+   }
    return 0;
 }
@@ -41,37 +41,6 @@ void Sentence::read(istream& is) throw() {
    }
 }
 
-void Sentence::regWordsInSentence() {
-   vector<Word>::iterator word_it;
-   word_it = begin();
-   while( word_it != end() ) {
-      (*word_it).addSenToWord(sen_id);
-      word_it++;
-   }
-}
-
-void Sentence::getSimilars() {
-   vector<Word>::iterator word_it;
-   word_it = begin();
-   while( word_it != end() ) {
-      for ( Word::simil_iterator s=(*word_it).simil_begin();
-                                 s != (*word_it).simil_end(); s++) {
-         if (*s > sen_id) {
-            similars.insert(*s);
-         }
-      }
-      word_it++;
-   }
-}
-
-bool Sentence::isSimilarTo(int id) {
-   if (similars.find(id) != similars.end()) {
-      return true;
-   } else {
-      return false;
-   }
-}
-
 ostream& operator<<(ostream& os, const Sentence& s) {
    s.write(os);
    return os;
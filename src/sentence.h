@@ -48,8 +48,6 @@ class Sentence:public vector<Word> {
 
       // data structure
       int sen_id;            // storing the sentence ID
-      set<int> similars;     // keeping track of sentences to
-                                       // compare with
    public:
       string comment_line;
 
@@ -63,22 +61,6 @@ class Sentence:public vector<Word> {
          return sen_id;
       }
 
-      // This procedure considers each word in the sentence and registers
-      // its appearance in the current sentence to facilitate future
-      // decisions on which sentences to compare with. It should be called
-      // while reading in the full treebank line by line.
-      void regWordsInSentence();
-
-      // This procedure considers each word in the sentence and fills the
-      // set "similars" with sentences to compare with as these sentences
-      // have at least one word in common.
-      void getSimilars();
-
-      // This procedure returns true if the current sentence has in its
-      // "similars" set the sentence specified with argument "id", and
-      // returns false if it has not.
-      bool isSimilarTo(int id);
-
       // constructors
       Sentence() throw() :vector<Word>() { comment_line=""; }
       template <class In>
@@ -0,0 +1,335 @@
+/******************************************************************************»
+ **
+ **   Filename    : shard.h
+ **
+ **   Description : This file contains the format of the files that
+ **                 abl_align writes for a shard of the sentence pairs and
+ **                 abl_merge reads. A shard file starts with a
+ **                 Shard_header line, followed by the Events of the
+ **                 sentence pairs of the shard that may change the
+ **                 treebank, in the order in which a single run handles
+ **                 the pairs (see Event_writer).
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __shard__
+#define __shard__
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+#include "edit_distance.h"
+#include "hypotheses.h"
+
+using namespace std;
+
+namespace ns_shard {
+
+using ns_edit_distance::Alignment;
+using ns_edit_distance::Segment;
+using ns_hypotheses::Part_type;
+
+// Return a fingerprint of the sentences b to e-1 (a hash of their words).
+// Ran needs to be a random access iterator over Trees.
+template <class Ran>
+uint64_t fingerprint(Ran b, Ran e) {
+   uint64_t h=14695981039346656037ULL; // FNV-1a
+   for (Ran s=b; s != e; ++s) {
+      ostringstream os;
+      for (typename Ran::value_type::const_iterator w=s->begin();
+        w != s->end(); ++w) {
+         os << *w << ' ';
+      }
+      os << '\n';
+      string line=os.str();
+      for (string::const_iterator c=line.begin(); c != line.end(); ++c) {
+         h=(h^(unsigned char)*c)*1099511628211ULL;
+      }
+   }
+   return h;
+}
+
+struct Shard_header {
+   // This class describes a shard: its number (1 to shards), the number of
+   // sentences that are aligned with their fingerprint, the settings that
+   // decide which pairs are aligned and how, and the settings that decide
+   // how the hypotheses are inserted. Shards can only be merged if all of
+   // this (except the number) is equal. The line looks like
+   //    abl_shard 2 4 300 u 0 0 0 wb 0 -1 -1 100 1 0 i 20 5 1 8c2f1b0e6a3d9f47
+   Shard_header() throw():shard(0),shards(0),sentences(0),
+     part_type(ns_hypotheses::UNEQUAL),nomerge(false),excl_empty(false),
+     collapse(false),exhaustive(false),max_distance(-1),band(-1),
+     max_frequency(100),min_shared(1),min_overlap(0),candidates('i'),lsh_bands(0),
+     lsh_rows(0),lsh_shingle(0),fingerprint(0) { }
+
+   int shard;
+   int shards;
+   int sentences;
+   Part_type part_type;
+   bool nomerge;
+   bool excl_empty;
+   bool collapse;
+   string align;           // alignment type (wm or wb)
+   bool exhaustive;
+   float max_distance;
+   int band;
+   double max_frequency;
+   int min_shared;
+   int min_overlap;
+   char candidates;        // i (index) or l (lsh)
+   int lsh_bands;
+   int lsh_rows;
+   int lsh_shingle;
+   uint64_t fingerprint;   // of the sentences
+
+   // Return the name of the first setting in which shard h differs from
+   // this one, or an empty string if they can be merged.
+   string differs(const Shard_header& h) const {
+      if (h.shards != shards) { return "number of shards"; }
+      if ((h.sentences != sentences)||(h.fingerprint != fingerprint)) {
+         return "input";
+      }
+      if (h.part_type != part_type) { return "part type"; }
+      if (h.nomerge != nomerge) { return "nomerge"; }
+      if (h.excl_empty != excl_empty) { return "excl_empty"; }
+      if (h.collapse != collapse) { return "collapse"; }
+      if (h.align != align) { return "alignment type"; }
+      if (h.exhaustive != exhaustive) { return "exhaustive"; }
+      if (h.max_distance != max_distance) { return "max_distance"; }
+      if (h.band != band) { return "band"; }
+      if (h.max_frequency != max_frequency) { return "max_frequency"; }
+      if (h.min_shared != min_shared) { return "min_shared"; }
+      if (h.min_overlap != min_overlap) { return "min_overlap"; }
+      if (h.candidates != candidates) { return "candidates"; }
+      if ((h.lsh_bands != lsh_bands)||(h.lsh_rows != lsh_rows)
+        ||(h.lsh_shingle != lsh_shingle)) {
+         return "lsh parameters";
+      }
+      return "";
+   }
+
+   void write(ostream& os) const {
+      os << "abl_shard " << shard << " " << shards << " " << sentences << " "
+         << "eub"[part_type] << " " << nomerge << " " << excl_empty << " "
+         << collapse << " " << align << " " << exhaustive << " "
+         << setprecision(17) << max_distance << " " << band << " "
+         << max_frequency << " " << min_shared << " " << min_overlap << " "
+         << candidates << " " << lsh_bands << " " << lsh_rows << " "
+         << lsh_shingle << " "
+         << hex << fingerprint << dec << "\n";
+   }
+
+   // This procedure reads the header and returns false if it is not well
+   // formed.
+   bool read(istream& is) {
+      string line, tag;
+      char part=0;
+      if (!getline(is, line)) {
+         return false;
+      }
+      istringstream ls(line);
+      ls >> tag >> shard >> shards >> sentences >> part >> nomerge
+         >> excl_empty >> collapse >> align >> exhaustive >> max_distance
+         >> band >> max_frequency >> min_shared >> min_overlap >> candidates
+         >> lsh_bands >> lsh_rows >> lsh_shingle >> hex >> fingerprint >> dec;
+      string parts="eub";
+      if (!ls||(tag != "abl_shard")||(parts.find(part) == string::npos)
+        ||(shards < 1)||(shard < 1)||(shard > shards)) {
+         return false;
+      }
+      part_type=Part_type(parts.find(part));
+      return true;
+   }
+};
+
+struct Event {
+   // This class holds the outcome of aligning sentence first with the
+   // later sentence second (positions in the treebank), or, if reversed,
+   // of aligning second with first (see both_orders in align.cpp). Only
+   // the SAME segments of the alignment are kept: the segments alternate,
+   // so the DIFF segments are the gaps between them (see complete).
+   int first;
+   int second;
+   bool reversed;
+   Alignment alignment;
+
+   // Return true if the segments link words in increasing order within
+   // sentences of size1 and size2 words.
+   bool fits(const int size1, const int size2) const throw() {
+      int i=0, j=0; // where the next segment may begin
+      for (Alignment::const_iterator s=alignment.begin();
+        s != alignment.end(); ++s) {
+         // two SAME segments are always separated by a DIFF segment
+         if ((s->kind != ns_edit_distance::SAME)||(s->length < 1)
+           ||(s->begin1 < i)||(s->begin2 < j)
+           ||((s != alignment.begin())&&(s->begin1 == i)&&(s->begin2 == j))) {
+            return false;
+         }
+         i=s->begin1+s->length;
+         j=s->begin2+s->length;
+         if ((i > size1)||(j > size2)) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   // This procedure adds the DIFF segments to the alignment of sentences
+   // of size1 and size2 words (which fits).
+   void complete(const int size1, const int size2) {
+      Alignment a;
+      int i=0, j=0;
+      for (Alignment::const_iterator s=alignment.begin();
+        s != alignment.end(); ++s) {
+         if ((s->begin1 > i)||(s->begin2 > j)) {
+            a.push_back(Segment(i, j, s->begin1-i+s->begin2-j,
+              ns_edit_distance::DIFF));
+         }
+         a.push_back(*s);
+         i=s->begin1+s->length;
+         j=s->begin2+s->length;
+      }
+      if ((i < size1)||(j < size2)) {
+         a.push_back(Segment(i, j, size1-i+size2-j,
+           ns_edit_distance::DIFF));
+      }
+      alignment.swap(a);
+   }
+};
+
+class Event_writer {
+   // This class writes the events of a shard. The pairs of a sentence
+   // follow a line with a colon and its position. A pair is a line with
+   // the distance of its later sentence to that of the previous pair (or
+   // to the sentence), an r if reversed, and the SAME segments as begin1
+   // begin2 length, like
+   //    :12
+   //    28 0 0 2 5 4 1
+   //    0 r 0 0 2 4 5 1
+   // The last line holds the number of pairs that were abandoned and of
+   // the pairs that were left out because they change nothing, like
+   //    abl_shard_end 3 120
+public:
+   Event_writer(ostream& o) throw():os(o),row(-1),last(0) { }
+
+   void write(const Event& e) {
+      if (e.first != row) {
+         row=e.first;
+         last=row;
+         os << ":" << row << "\n";
+      }
+      os << e.second-last;
+      last=e.second;
+      if (e.reversed) {
+         os << " r";
+      }
+      for (Alignment::const_iterator s=e.alignment.begin();
+        s != e.alignment.end(); ++s) {
+         if (s->kind == ns_edit_distance::SAME) {
+            os << " " << s->begin1 << " " << s->begin2 << " " << s->length;
+         }
+      }
+      os << "\n";
+   }
+
+   void finish(const long abandoned, const long left_out) {
+      os << "abl_shard_end " << abandoned << " " << left_out << "\n";
+   }
+
+private:
+   ostream& os;
+   int row;   // sentence of the pairs
+   int last;  // later sentence of the previous pair
+};
+
+class Event_reader {
+   // This class reads the events that an Event_writer wrote. The numbers
+   // are read with strtol, which is much faster than a stream.
+public:
+   Event_reader(istream& i) throw():ended(false),abandoned(0),left_out(0),
+     is(i),row(-1),last(0) { }
+
+   // This procedure reads the next event into e and returns false after
+   // the last one, or if a line is not well formed (then ended is false).
+   bool read(Event& e) {
+      while (getline(is, line)) {
+         const char* p=line.c_str();
+         char* q;
+         if (*p == ':') {
+            row=strtol(p+1, &q, 10);
+            last=row;
+            if ((q == p+1)||(*q != '\0')) {
+               return false;
+            }
+            continue;
+         }
+         if (line.compare(0, 14, "abl_shard_end ") == 0) {
+            istringstream ls(line.substr(14));
+            ended=(ls >> abandoned >> left_out)&&(ls >> ws).eof()
+              &&!getline(is, line);
+            return false;
+         }
+         if (row < 0) {
+            return false;
+         }
+         long d=strtol(p, &q, 10);
+         if ((q == p)||(d < 0)) {
+            return false;
+         }
+         e.first=row;
+         e.second=last+d;
+         last=e.second;
+         e.reversed=false;
+         e.alignment.clear();
+         p=q;
+         while (*p == ' ') {
+            p++;
+         }
+         if ((*p == 'r')&&((p[1] == ' ')||(p[1] == '\0'))) {
+            e.reversed=true;
+            p++;
+         }
+         for (;;) {
+            long v[3];
+            for (int k=0; k<3; k++) {
+               v[k]=strtol(p, &q, 10);
+               if (q == p) {
+                  if ((k == 0)&&(*p == '\0')) {
+                     return true;
+                  }
+                  return false;
+               }
+               p=q;
+            }
+            e.alignment.push_back(Segment(v[0], v[1], v[2],
+              ns_edit_distance::SAME));
+         }
+      }
+      return false;
+   }
+
+   bool ended;      // the end line was read (and nothing follows it)
+   long abandoned;  // from the end line
+   long left_out;
+
+private:
+   istream& is;
+   int row;
+   int last;
+   string line;
+};
+
+} // namespace
+
+#endif // __shard__
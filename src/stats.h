@@ -0,0 +1,263 @@
+/******************************************************************************»
+ **
+ **   Filename    : stats.h
+ **
+ **   Description : This file contains the definitions of the classes
+ **                 Stats and Histogram, which collect the figures of a run
+ **                 of one of the programs: the wall clock and processor
+ **                 time of its phases, counters, histograms and the peak
+ **                 memory use. They are written as a JSON object (the
+ **                 --stats option). Collecting them costs a few clock
+ **                 readings per phase and per group of aligned pairs.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __stats__
+#define __stats__
+
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "config.h"
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+namespace ns_stats {
+
+// Return the wall clock time in seconds since some fixed moment.
+inline double wall_time() throw() {
+#ifdef CLOCK_MONOTONIC
+   timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec+t.tv_nsec*1e-9;
+#else
+   return double(time(0));
+#endif
+}
+
+// This procedure writes s to os as a JSON string.
+inline void write_json(ostream& os, const string& s) {
+   os << '"';
+   for (string::const_iterator c=s.begin(); c != s.end(); ++c) {
+      if ((*c == '"')||(*c == '\\')) {
+         os << '\\' << *c;
+      } else if ((unsigned char)*c < 0x20) {
+         os << "\\u00" << hex << setw(2) << setfill('0') << int(*c) << dec
+            << setfill(' ');
+      } else {
+         os << *c;
+      }
+   }
+   os << '"';
+}
+
+class Histogram {
+   // This class counts values in buckets of powers of two: bucket 0 holds
+   // the values below 1 and bucket k the values from 2^(k-1) up to 2^k.
+public:
+   Histogram() throw():count(0),sum(0),max(0) { }
+
+   // This procedure adds n times the value x.
+   void add(const double x, const long n=1) {
+      int k=0;
+      if (x >= 1) {
+         frexp(x, &k);
+      }
+      if (k >= int(buckets.size())) {
+         buckets.resize(k+1, 0);
+      }
+      buckets[k]+=n;
+      count+=n;
+      sum+=x*n;
+      if (x > max) {
+         max=x;
+      }
+   }
+
+   // This procedure adds the values of h.
+   void add(const Histogram& h) {
+      if (h.buckets.size() > buckets.size()) {
+         buckets.resize(h.buckets.size(), 0);
+      }
+      for (int k=0; k<int(h.buckets.size()); k++) {
+         buckets[k]+=h.buckets[k];
+      }
+      count+=h.count;
+      sum+=h.sum;
+      if (h.max > max) {
+         max=h.max;
+      }
+   }
+
+   // This procedure writes the histogram as a JSON object. Every bucket
+   // gives the lower bound of its values (from) and the number of values.
+   void write(ostream& os) const {
+      os << "{\"count\": " << count << ", \"sum\": " << sum << ", \"max\": "
+         << max << ", \"buckets\": [";
+      bool first=true;
+      for (int k=0; k<int(buckets.size()); k++) {
+         if (buckets[k] == 0) {
+            continue;
+         }
+         os << (first?"":", ") << "{\"from\": "
+            << ((k == 0)?0:ldexp(1.0, k-1)) << ", \"count\": " << buckets[k]
+            << "}";
+         first=false;
+      }
+      os << "]}";
+   }
+
+   long count;
+   double sum;
+   double max;
+   vector<long> buckets;
+};
+
+class Stats {
+public:
+   Stats() throw():start_wall(0),start_cpu(0) { }
+
+   // This procedure ends the running phase (if any) and starts phase
+   // name.
+   void begin(const string& name) {
+      end();
+      running=name;
+      start_wall=wall_time();
+      start_cpu=clock();
+   }
+
+   // This procedure ends the running phase (if any). A phase that runs
+   // more than once adds up.
+   void end() {
+      if (running.empty()) {
+         return;
+      }
+      Phase& p=phase(running);
+      p.wall+=wall_time()-start_wall;
+      p.cpu+=double(clock()-start_cpu)/CLOCKS_PER_SEC;
+      running.clear();
+   }
+
+   // This procedure sets the counter name to value. The counters are
+   // written in the order in which they are first set.
+   void set(const string& name, const long value) {
+      for (vector<pair<string, long> >::iterator c=counters.begin();
+        c != counters.end(); ++c) {
+         if (c->first == name) {
+            c->second=value;
+            return;
+         }
+      }
+      counters.push_back(make_pair(name, value));
+   }
+
+   // Return the histogram name (which is new if it did not exist).
+   Histogram& histogram(const string& name) {
+      for (vector<pair<string, Histogram> >::iterator h=histograms.begin();
+        h != histograms.end(); ++h) {
+         if (h->first == name) {
+            return h->second;
+         }
+      }
+      histograms.push_back(make_pair(name, Histogram()));
+      return histograms.back().second;
+   }
+
+   // This procedure ends the running phase and writes everything as a
+   // JSON object to the file name. It returns false if that fails.
+   bool write(const string& name, const string& program, const int argc,
+     char** argv) {
+      end();
+      ofstream os(name.c_str());
+      os << setprecision(15);
+      os << "{\n  \"program\": ";
+      write_json(os, program);
+      os << ",\n  \"command\": [";
+      for (int i=0; i<argc; i++) {
+         os << (i?", ":"");
+         write_json(os, argv[i]);
+      }
+      os << "],\n  \"phases\": [";
+      for (int i=0; i<int(phases.size()); i++) {
+         os << (i?",":"") << "\n    {\"name\": ";
+         write_json(os, phases[i].name);
+         os << ", \"wall_seconds\": " << phases[i].wall
+            << ", \"cpu_seconds\": " << phases[i].cpu << "}";
+      }
+      os << "\n  ],\n  \"counters\": {";
+      for (int i=0; i<int(counters.size()); i++) {
+         os << (i?",":"") << "\n    ";
+         write_json(os, counters[i].first);
+         os << ": " << counters[i].second;
+      }
+      os << "\n  },\n  \"histograms\": {";
+      for (int i=0; i<int(histograms.size()); i++) {
+         os << (i?",":"") << "\n    ";
+         write_json(os, histograms[i].first);
+         os << ": ";
+         histograms[i].second.write(os);
+      }
+      os << "\n  },\n  \"peak_rss_kb\": " << peak_rss() << "\n}\n";
+      return os.good();
+   }
+
+   // Return the largest amount of memory the process has used, in
+   // kilobytes (0 if unknown).
+   static long peak_rss() throw() {
+#ifdef HAVE_SYS_RESOURCE_H
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) == 0) {
+         return usage.ru_maxrss;
+      }
+#endif
+      return 0;
+   }
+
+private:
+   struct Phase {
+      string name;
+      double wall;   // seconds
+      double cpu;    // seconds of processor time (all threads)
+   };
+
+   // Return the phase name (which is new if it did not exist).
+   Phase& phase(const string& name) {
+      for (vector<Phase>::iterator p=phases.begin(); p != phases.end(); ++p) {
+         if (p->name == name) {
+            return *p;
+         }
+      }
+      Phase p={name, 0, 0};
+      phases.push_back(p);
+      return phases.back();
+   }
+
+   vector<Phase> phases;
+   string running;             // name of the running phase
+   double start_wall;          // when the running phase started
+   clock_t start_cpu;
+   vector<pair<string, long> > counters;
+   vector<pair<string, Histogram> > histograms;
+};
+
+
+} // namespace
+
+#endif // __stats__
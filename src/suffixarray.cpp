@@ -0,0 +1,302 @@
+/******************************************************************************»
+ **
+ **   Filename    : suffixarray.cpp
+ **
+ **   Description : This file contains the implementation of the class
+ **                 Suffixarray.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#include <algorithm>
+#include "suffixarray.h"
+#include "tree.h"
+#include "word.h"
+
+namespace ns_suffixarray {
+
+using ns_tree::Tree;
+using ns_word::Word;
+
+// This procedure sets bkt[c] to the start (or, if end, the end) of the
+// bucket of the suffixes of s that start with c.
+static void get_buckets(const int* s, const int n, vector<int>& bkt,
+  const bool end) {
+   fill(bkt.begin(), bkt.end(), 0);
+   for (int i=0; i<n; i++) {
+      bkt[s[i]]++;
+   }
+   int sum=0;
+   for (int c=0; c<int(bkt.size()); c++) {
+      sum+=bkt[c];
+      bkt[c]=end?sum:sum-bkt[c];
+   }
+}
+
+// These procedures induce the order of the L-type (S-type) suffixes from
+// the ones already in sa.
+static void induce_l(const vector<bool>& t, int* sa, const int* s,
+  const int n, vector<int>& bkt) {
+   get_buckets(s, n, bkt, false);
+   for (int i=0; i<n; i++) {
+      int j=sa[i]-1;
+      if ((sa[i] > 0)&&!t[j]) {
+         sa[bkt[s[j]]++]=j;
+      }
+   }
+}
+
+static void induce_s(const vector<bool>& t, int* sa, const int* s,
+  const int n, vector<int>& bkt) {
+   get_buckets(s, n, bkt, true);
+   for (int i=n-1; i>=0; i--) {
+      int j=sa[i]-1;
+      if ((sa[i] > 0)&&t[j]) {
+         sa[--bkt[s[j]]]=j;
+      }
+   }
+}
+
+// Return true if suffix i is a leftmost S-type suffix.
+static inline bool is_lms(const vector<bool>& t, const int i) {
+   return (i > 0)&&t[i]&&!t[i-1];
+}
+
+// This procedure sorts the suffixes of s (n values below k, of which
+// only the last one, s[n-1], is 0) into sa with the SA-IS algorithm of
+// Nong, Zhang and Chan, which takes linear time. The reduced problem is
+// kept in sa itself.
+static void sais(const int* s, int* sa, const int n, const int k) {
+   vector<bool> t(n);  // true for S-type suffixes
+   t[n-1]=true;
+   if (n > 1) {
+      t[n-2]=false;
+   }
+   for (int i=n-3; i>=0; i--) {
+      t[i]=(s[i] < s[i+1])||((s[i] == s[i+1])&&t[i+1]);
+   }
+   vector<int> bkt(k);
+   get_buckets(s, n, bkt, true);
+   fill(sa, sa+n, -1);
+   for (int i=1; i<n; i++) {
+      if (is_lms(t, i)) {
+         sa[--bkt[s[i]]]=i;
+      }
+   }
+   induce_l(t, sa, s, n, bkt);
+   induce_s(t, sa, s, n, bkt);
+
+   // name the sorted LMS substrings
+   int n1=0;
+   for (int i=0; i<n; i++) {
+      if (is_lms(t, sa[i])) {
+         sa[n1++]=sa[i];
+      }
+   }
+   fill(sa+n1, sa+n, -1);
+   int name=0;
+   int prev=-1;
+   for (int i=0; i<n1; i++) {
+      int pos=sa[i];
+      bool diff=false;
+      for (int d=0; d<n; d++) {
+         if ((prev == -1)||(s[pos+d] != s[prev+d])||(t[pos+d] != t[prev+d])) {
+            diff=true;
+            break;
+         } else if ((d > 0)&&(is_lms(t, pos+d)||is_lms(t, prev+d))) {
+            break;
+         }
+      }
+      if (diff) {
+         name++;
+         prev=pos;
+      }
+      sa[n1+pos/2]=name-1;
+   }
+   for (int i=n-1, j=n-1; i>=n1; i--) {
+      if (sa[i] >= 0) {
+         sa[j--]=sa[i];
+      }
+   }
+
+   // sort the reduced string (recursively if names repeat)
+   int* s1=sa+n-n1;
+   if (name < n1) {
+      sais(s1, sa, n1, name);
+   } else {
+      for (int i=0; i<n1; i++) {
+         sa[s1[i]]=i;
+      }
+   }
+
+   // induce the order of all suffixes from the sorted LMS suffixes
+   get_buckets(s, n, bkt, true);
+   for (int i=1, j=0; i<n; i++) {
+      if (is_lms(t, i)) {
+         s1[j++]=i;
+      }
+   }
+   for (int i=0; i<n1; i++) {
+      sa[i]=s1[sa[i]];
+   }
+   fill(sa+n1, sa+n, -1);
+   for (int i=n1-1; i>=0; i--) {
+      int j=sa[i];
+      sa[i]=-1;
+      sa[--bkt[s[j]]]=j;
+   }
+   induce_l(t, sa, s, n, bkt);
+   induce_s(t, sa, s, n, bkt);
+}
+
+void Suffixarray::construct(const int i) {
+   starts.push_back(text.size());
+   lines.push_back(i);
+   for (Tree::const_iterator w=SS[i].begin(); w != SS[i].end(); ++w) {
+      text.push_back(w->getIdx()+1);
+   }
+   text.push_back(1);
+}
+
+void Suffixarray::align(Ftree* ft) {
+   if (starts.empty()) {
+      return;
+   }
+   text.push_back(0);
+   const int n=text.size();
+   vector<int> sa(n);
+   sais(&text[0], &sa[0], n, Word::vocabulary_size()+2);
+
+   // plcp[i] is the number of words suffix i shares with the suffix
+   // before it in sa (Kaerkkaeinen, Manzini and Puglisi's Phi algorithm)
+   vector<int> plcp(n);
+   plcp[sa[0]]=-1;
+   for (int i=1; i<n; i++) {
+      plcp[sa[i]]=sa[i-1];
+   }
+   for (int i=0, l=0; i<n; i++) {
+      int j=plcp[i];
+      if (j < 0) {
+         l=0;
+      } else {
+         while ((text[i+l] > 1)&&(text[i+l] == text[j+l])) {
+            l++;
+         }
+      }
+      plcp[i]=l;
+      if (l > 0) {
+         l--;
+      }
+   }
+
+   // lpf[i] is the largest number of words suffix i shares with an
+   // earlier suffix. The tree adds the leaf of suffix i at word i+lpf[i],
+   // so suffix i+1 becomes active with the active point on the word
+   // before it (Crochemore and Ilie; the earlier suffixes closest to i in
+   // sa are found with a stack)
+   vector<int> lpf(n, 0);
+   vector<pair<int, int> > stack;  // suffix, LCP with the one below it
+   for (int pass=0; pass<2; pass++) {
+      stack.clear();
+      for (int k=0; k<n; k++) {
+         int r=pass?n-1-k:k;
+         int shared=(k == 0)?0:plcp[sa[pass?r+1:r]];
+         while (!stack.empty()&&(stack.back().first > sa[r])) {
+            shared=min(shared, stack.back().second);
+            stack.pop_back();
+         }
+         if (!stack.empty()) {
+            lpf[sa[r]]=max(lpf[sa[r]], shared);
+         }
+         stack.push_back(make_pair(sa[r], shared));
+      }
+   }
+
+   // the suffixes that start with a word, in the order of the words
+   int nterm=0;
+   int lo=0;
+   vector<pair<int, int> > found;  // sentence, position
+   while (lo < n) {
+      int word=text[sa[lo]];
+      int hi=lo+1;
+      while ((hi < n)&&(text[sa[hi]] == word)) {
+         hi++;
+      }
+      if (word > 1) {
+         // The edge of the tree is the rest of the first sentence with the
+         // word, up to where another occurrence goes on with an other word.
+         // An occurrence that stops at the end of its sentence does not
+         // branch off.
+         int first=lo;
+         for (int k=lo+1; k<hi; k++) {
+            if (sa[k] < sa[first]) {
+               first=k;
+            }
+         }
+         int depth=rest(sa[first]);
+         int shared=depth;
+         for (int k=first+1; k<hi; k++) {
+            shared=min(shared, plcp[sa[k]]);
+            if ((shared < depth)&&(shared < rest(sa[k]))) {
+               depth=shared;
+            }
+         }
+         shared=depth;
+         for (int k=first-1; k>=lo; k--) {
+            shared=min(shared, plcp[sa[k+1]]);
+            if ((shared < depth)&&(shared < rest(sa[k]))) {
+               depth=shared;
+            }
+         }
+
+         // The occurrences that end within the edge are left out. The tree
+         // stores a suffix that covers the edge when it becomes active, at
+         // the position of the active point, and keeps a position of a
+         // sentence once.
+         found.clear();
+         for (int k=lo; k<hi; k++) {
+            if (rest(sa[k]) >= depth) {
+               int line=line_of(sa[k]);
+               int p=sa[k]-starts[line]+depth;
+               if ((sa[k] > starts[line])&&(lpf[sa[k]-1] < rest(sa[k]-1))) {
+                  p=max(p, sa[k]-1-starts[line]+lpf[sa[k]-1]);
+               }
+               found.push_back(make_pair(line, p));
+            }
+         }
+         sort(found.begin(), found.end());
+         found.erase(unique(found.begin(), found.end()), found.end());
+         if (!found.empty()&&(found.front().first != found.back().first)) {
+            nterm++;
+            for (vector<pair<int, int> >::const_iterator f=found.begin();
+              f != found.end(); ++f) {
+               if (fix) {
+                  ft[lines[f->first]].prefs[f->second][nterm]++;
+               } else {
+                  ft[lines[f->first]].sufs[f->second][nterm]++;
+               }
+            }
+         }
+      }
+      lo=hi;
+   }
+}
+
+int Suffixarray::line_of(const int i) const {
+   return upper_bound(starts.begin(), starts.end(), i)-starts.begin()-1;
+}
+
+int Suffixarray::rest(const int i) const {
+   unsigned int line=line_of(i)+1;
+   int end=(line < starts.size())?starts[line]-1:text.size()-2;
+   return end-i;
+}
+
+} // namespace
@@ -0,0 +1,70 @@
+/******************************************************************************»
+ **
+ **   Filename    : suffixarray.h
+ **
+ **   Description : This file contains the definition of the class
+ **                 Suffixarray, an index of the suffixes of the sentences
+ **                 for the methods st1 to st4 that uses a generalized
+ **                 suffix array and its LCP array instead of a suffix
+ **                 tree. It needs four integers per word, so it also
+ **                 works on corpora for which the suffix tree is too
+ **                 large.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __suffixarray__
+#define __suffixarray__
+
+#include <vector>
+#include "suffixtree.h"
+#include "treebank.h"
+
+using namespace std;
+
+namespace ns_suffixarray {
+
+using ns_suffixtree::Ftree;
+using ns_suffixtree::Suffix_index;
+using ns_treebank::Treebank;
+
+class Suffixarray:public Suffix_index {
+   // The sentences are kept as one text of word indexes, each sentence
+   // followed by a separator. The suffixes that start with the same word
+   // form a range of the suffix array. The edge of the root of the suffix
+   // tree for that word runs from the first of these suffixes to the
+   // first word where another one differs (found with the LCP values);
+   // as in the tree, a suffix that reaches the end of its sentence first
+   // does not shorten the edge and is not stored. The tree also stores
+   // positions where its suffix links send the active point, which the
+   // array cannot see, so the two agree on most but not all positions.
+public:
+   Suffixarray(Treebank& tb) throw():SS(tb) { }
+
+   void construct(const int i);
+   void align(Ftree* ft);
+
+private:
+   Treebank& SS;
+   vector<int> text;    // 0 ends the text, 1 ends a sentence, a word w is
+                        // its index plus 1
+   vector<int> starts;  // where each sentence starts in text
+   vector<int> lines;   // the number of each sentence in the treebank
+
+   // These functions return the sentence of position i of text and the
+   // number of words from i to the end of that sentence.
+   int line_of(const int i) const;
+   int rest(const int i) const;
+};
+
+
+} // namespace
+
+#endif // __suffixarray__
@@ -17,6 +17,7 @@
  ******************************************************************************»
  */
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include "suffixtree.h"
@@ -24,101 +25,162 @@
 
 namespace ns_suffixtree {
 
-void Suffixtree::add_slink( int node_from, int node_to ) {
-   slinks_ft[ node_from ] = node_to;
-   slinks_tf[ node_to ] = node_from;
+Suffixtree::Suffixtree(Treebank& tb) : SS( tb ) {
+   nodecount=2;
+   new_node( 0, 0, 0, 0 ); // stands for no node
+   new_node( 0, 0, 0, 0 ); // the root
+   Child free_entry = { 0, 0 };
+   root_table.resize( 1024, free_entry );
+   root_children = 0;
+}
+
+int Suffixtree::new_node( int line_nr, int pos_begin, int pos_end, int parent ) {
+   Node n = { parent, 0, line_nr, pos_begin, pos_end, 0, 0, 0 };
+   nodes.push_back( n );
+   posities.push_back( senpos() );
+   return nodes.size() - 1;
 }
 
-int Suffixtree::get_slink_ft( int node_from ) {
-   return slinks_ft[ node_from ];
+// Return the first slot of the root table to look for word.
+static inline unsigned int root_hash( int word, unsigned int mask ) {
+   return ((unsigned int)word * 2654435761u) & mask;
 }
 
-int Suffixtree::get_slink_tf( int node_to ) {
-   return slinks_tf[ node_to ];
+int Suffixtree::child( int node, int word ) const {
+   if (node == 1) {
+      unsigned int mask = root_table.size() - 1;
+      for (unsigned int h = root_hash( word, mask ); ; h = (h + 1) & mask) {
+         if ( (root_table[ h ].node == 0) || (root_table[ h ].word == word) ) {
+            return root_table[ h ].node;
+         }
+      }
+   }
+   const Node& n = nodes[ node ];
+   for (int c = n.first_child; c != n.first_child + n.children; c++) {
+      if (child_table[ c ].word >= word) {
+         return (child_table[ c ].word == word) ? child_table[ c ].node : 0;
+      }
+   }
+   return 0;
+}
+
+void Suffixtree::set_child( int node, int word, int child ) {
+   if (node == 1) {
+      if (2 * (root_children + 1) > int(root_table.size())) {
+         vector<Child> old;
+         old.swap( root_table );
+         Child free_entry = { 0, 0 };
+         root_table.resize( 2 * old.size(), free_entry );
+         root_children = 0;
+         for (vector<Child>::const_iterator c = old.begin(); c != old.end(); ++c) {
+            if (c->node != 0) {
+               set_child( 1, c->word, c->node );
+            }
+         }
+      }
+      unsigned int mask = root_table.size() - 1;
+      unsigned int h = root_hash( word, mask );
+      while ( (root_table[ h ].node != 0) && (root_table[ h ].word != word) ) {
+         h = (h + 1) & mask;
+      }
+      if (root_table[ h ].node == 0) {
+         root_children++;
+      }
+      root_table[ h ].word = word;
+      root_table[ h ].node = child;
+      return;
+   }
+   int c = nodes[ node ].first_child;
+   int e = c + nodes[ node ].children;
+   while ( (c != e) && (child_table[ c ].word < word) ) {
+      c++;
+   }
+   if ( (c != e) && (child_table[ c ].word == word) ) {
+      child_table[ c ].node = child;
+      return;
+   }
+   Node& n = nodes[ node ];
+   if (n.children == n.capacity) { // move to a larger block at the end
+      int first = child_table.size();
+      n.capacity = (n.capacity == 0) ? 2 : 2 * n.capacity;
+      child_table.resize( first + n.capacity );
+      copy( child_table.begin() + n.first_child,
+            child_table.begin() + e, child_table.begin() + first );
+      c += first - n.first_child;
+      n.first_child = first;
+      e = first + n.children;
+   }
+   copy_backward( child_table.begin() + c, child_table.begin() + e,
+                  child_table.begin() + e + 1 );
+   child_table[ c ].word = word;
+   child_table[ c ].node = child;
+   n.children++;
 }
 
-void Suffixtree::add_edge( Edge &e ) {
-   int a,b;
-   a = e.node_begin;
-   b = SS[ e.line_nr ][ e.pos_begin ].getIdx();
-   Edges[ a ][ b ] = e;
+void Suffixtree::add_slink( int node_from, int node_to ) {
+   nodes[ node_from ].slink = node_to;
 }
 
-void Suffixtree::del_edge( Edge &e ) {
-   int a,b;
-   a = e.node_begin;
-   b = SS[ e.line_nr ][ e.pos_begin ].getIdx();
-   Edges[ a ].erase( b );
+int Suffixtree::get_slink_ft( int node_from ) const {
+   return nodes[ node_from ].slink;
 }
 
-Suffixtree::Edge::Edge( int n, int init_first, int init_last, int parent_node, int child_node) {
-   line_nr = n;
-   pos_begin = init_first;
-   pos_end = init_last;
-   node_begin = parent_node;
-   node_end = child_node;
-   posities[ n ][ pos_end ]++;
+void Suffixtree::add_edge( int node ) {
+   const Node& n = nodes[ node ];
+   set_child( n.parent, SS[ n.line_nr ][ n.pos_begin ].getIdx(), node );
 }
 
-void Suffixtree::Edge::adjust_points(int l) {
-   for(map<int,vecpos>::iterator it1 = posities.begin(); it1 != posities.end(); ++it1) {
+// This procedure moves the end positions in p l words back.
+static void adjust_points( senpos& p, int l ) {
+   for(senpos::iterator it1 = p.begin(); it1 != p.end(); ++it1) {
       vecpos t;
-      t = posities[ (*it1).first ];
-      posities[ (*it1).first ].clear();
-      for (map<int,int>::iterator it2 = t.begin(); it2 != t.end(); ++it2) {
-         posities[ (*it1).first ][ (*it2).first - l ]++;
+      t.swap( (*it1).second );
+      for (vecpos::iterator it2 = t.begin(); it2 != t.end(); ++it2) {
+         (*it1).second[ (*it2).first - l ]++;
       }
    }
 }
 
-int Suffixtree::split_edge( Edge &e, Suffix &s ) {
-   del_edge(e);
-   Edge *new_edge =
-        new Edge( e.line_nr,
-                  e.pos_begin,
-                  e.pos_begin + s.pos_stop - s.pos_start,
-                  s.origin_node,
-                  nodecount++);
-
-   new_edge->posities = e.posities;
-   int edge_span = e.pos_end - e.pos_begin;
-   new_edge->adjust_points(edge_span - (s.pos_stop - s.pos_start));
-   new_edge->posities[ N ][ s.pos_stop ]++;
-   add_edge(*new_edge);
-   prevnode[ new_edge->node_end ] = new_edge->node_begin;
-   add_slink( new_edge->node_end, s.origin_node );
-   e.pos_begin += s.pos_stop - s.pos_start + 1;
-   e.node_begin = new_edge->node_end;
-   add_edge(e);
-   prevnode[ e.node_end ] = e.node_begin;
-   int retval = new_edge->node_end;
-   delete new_edge;
-   return retval;
+int Suffixtree::split_edge( int node, Suffix &s ) {
+   int span = s.pos_stop - s.pos_start;
+   int edge_span = nodes[ node ].pos_end - nodes[ node ].pos_begin;
+   int new_edge = new_node( nodes[ node ].line_nr,
+                            nodes[ node ].pos_begin,
+                            nodes[ node ].pos_begin + span,
+                            s.origin_node );
+   nodecount++;
+   posities[ new_edge ] = posities[ node ];
+   adjust_points( posities[ new_edge ], edge_span - span );
+   posities[ new_edge ][ N ][ s.pos_stop ]++;
+   add_edge( new_edge );
+   add_slink( new_edge, s.origin_node );
+   nodes[ node ].pos_begin += span + 1;
+   nodes[ node ].parent = new_edge;
+   add_edge( node );
+   return new_edge;
 }
 
 void Suffixtree::cano_suffix( Suffix &s ) {
    if ( !s.Explicit() ) {
-      if (Edges[ s.origin_node ].count( SS[ N ][ s.pos_start ].getIdx() ) ) {
-         Edge *e = &Edges[ s.origin_node ][ SS[ N ][ s.pos_start ].getIdx() ];
-         int edge_span = e->pos_end - e->pos_begin;
+      int e = child( s.origin_node, SS[ N ][ s.pos_start ].getIdx() );
+      if ( e != 0 ) {
+         int edge_span = nodes[ e ].pos_end - nodes[ e ].pos_begin;
          while ( edge_span <= ( s.pos_stop - s.pos_start ) ) {
-            e->posities[ N ][ s.pos_stop ]++;
+            posities[ e ][ N ][ s.pos_stop ]++;
             s.pos_start = s.pos_start + edge_span + 1;
-            s.origin_node = e->node_end;
+            s.origin_node = e;
             if ( s.pos_start <= s.pos_stop ) {
-               if (Edges[ e->node_end ].count( SS[ N ][ s.pos_start
-                       ].getIdx() ) ) {
-
-                  e = &Edges[ e->node_end ][ SS[ N ][ s.pos_start
-                       ].getIdx() ];
-
-                  edge_span = e->pos_end - e->pos_begin;
+               int f = child( e, SS[ N ][ s.pos_start ].getIdx() );
+               if ( f != 0 ) {
+                  e = f;
+                  edge_span = nodes[ e ].pos_end - nodes[ e ].pos_begin;
                }
             }
          }
       }
    }
 }
+
 void Suffixtree::add_prefix( Suffix &active, int pos_stop ) {
    int parent_node;
    int last_parent_node = -1;
@@ -127,50 +189,44 @@ void Suffixtree::add_prefix( Suffix &active, int pos_stop ) {
 
    while (!finished) {
 
-      Edge edge;
+      int edge = 0;
 
       parent_node = active.origin_node;
 
       if (just_jumped) {
+         // Lookups with operator[] add the position with count 0, which
+         // align() turns into hypotheses, so they are kept.
          int cnode = active.origin_node;
          int pnode;
 
          while (cnode > 1) {
             pnode = cnode;
-            cnode = prevnode[pnode];
+            cnode = nodes[ pnode ].parent;
 
-            map<int,Edge>::iterator ite = Edges[ cnode ].begin();
-            int edgefound = 0;
-
-            while ( ite != Edges[ cnode ].end() && !edgefound ) {
-               Edge *e = &Edges [ cnode ][ (*ite).first ];
-               if (e->node_end == pnode) {
-                  edgefound++;
-                  e->posities[ N ][ pos_stop-1 ];
-               } else {
-                  ++ite;
-               }
+            const Node& p = nodes[ pnode ];
+            if ( (cnode > 0)
+                 && (child( cnode, SS[ p.line_nr ][ p.pos_begin ].getIdx() ) == pnode) ) {
+               posities[ pnode ][ N ][ pos_stop-1 ];
             }
          }
          just_jumped--;
       }
 
       if ( active.Explicit() ) {
-         if ( Edges[active.origin_node].count( SS[ N ][ pos_stop ].getIdx() ) ) {
+         if ( child( active.origin_node, SS[ N ][ pos_stop ].getIdx() ) ) {
             finished++;
          }
       } else {
-         if ( Edges[ active.origin_node ].count( SS[ N ][ active.pos_start ].getIdx() ) ) {
-            edge = Edges[ active.origin_node ][ SS[ N ][ active.pos_start ].getIdx() ];
-         }
+         edge = child( active.origin_node, SS[ N ][ active.pos_start ].getIdx() );
 
          int span = active.pos_stop - active.pos_start;
 
-         if ( SS[ edge.line_nr ][ edge.pos_begin + span + 1 ] == SS[ N ][ pos_stop ] ) {
+         if ( SS[ nodes[ edge ].line_nr ][ nodes[ edge ].pos_begin + span + 1 ] == SS[ N ][ pos_stop ] ) {
             finished++;
-            if (Edges[ 1 ].count( SS[ N ][ pos_stop ].getIdx() ) ) {
-               if (get_slink_ft( Edges[ 1 ][ SS[ N ][ pos_stop ].getIdx() ].node_end ) == 1) {
-                  Edges[ 1 ][ SS[ N ][ pos_stop ].getIdx() ].posities[ N ][ pos_stop ];
+            int r = child( 1, SS[ N ][ pos_stop ].getIdx() );
+            if ( r ) {
+               if (get_slink_ft( r ) == 1) {
+                  posities[ r ][ N ][ pos_stop ];
                }
             }
          } else {
@@ -180,9 +236,10 @@ void Suffixtree::add_prefix( Suffix &active, int pos_stop ) {
 
       if (!finished) {
 
-         Edge *new_edge = new Edge( N, pos_stop, M, parent_node, nodecount++ );
-         add_edge( *new_edge );
-         prevnode[ new_edge->node_end ] = new_edge->node_begin;
+         int new_edge = new_node( N, pos_stop, M, parent_node );
+         nodecount++;
+         posities[ new_edge ][ N ][ M ]++;
+         add_edge( new_edge );
          if ( last_parent_node > 0 ) {
            add_slink( last_parent_node, parent_node );
          }
@@ -214,23 +271,25 @@ void Suffixtree::add_prefix( Suffix &active, int pos_stop ) {
 void Suffixtree::align(Ftree* ft){
    int nterm = 0;
 
-   map<int,Edge>::iterator ite = Edges[ 1 ].begin();
+   // the children of the root in the order of their first word
+   vector<pair<int, int> > children;
+   for (vector<Child>::const_iterator c = root_table.begin(); c != root_table.end(); ++c) {
+      if (c->node != 0) {
+         children.push_back( make_pair( c->word, c->node ) );
+      }
+   }
+   sort( children.begin(), children.end() );
 
-   while ( ite != Edges[ 1 ].end() ) {
-      Edge e = Edges [ 1 ][ (*ite).first ];
+   for (vector<pair<int, int> >::const_iterator ite = children.begin();
+        ite != children.end(); ++ite) {
+      const senpos& e = posities[ (*ite).second ];
 
-      if ( (e.posities.size() > 1) ) {
+      if ( (e.size() > 1) ) {
          nterm++;
 
-         for(map<int,vecpos>::iterator it1 = e.posities.begin(); it1 != e.posities.end(); ++it1) {
-            for (map<int,int>::iterator p = e.posities[ (*it1).first ].begin();
-               p != e.posities[ (*it1).first ].end(); ++p) {
-
-               constituentborder c_s, c_p;
-               c_s.p = (*p).first + 1;
-               c_s.n = nterm;
-               c_p.p = (*p).first - (e.pos_end - e.pos_begin);
-               c_p.n = nterm;
+         for(senpos::const_iterator it1 = e.begin(); it1 != e.end(); ++it1) {
+            for (vecpos::const_iterator p = (*it1).second.begin();
+               p != (*it1).second.end(); ++p) {
                if (fix) {
                   ft[ (*it1).first ].prefs[ (*p).first + 1 ][ nterm ]++;
                } else {
@@ -239,7 +298,6 @@ void Suffixtree::align(Ftree* ft){
             }
          }
       }
-      ++ite;
    }
 }
 
@@ -20,6 +20,9 @@
 #ifndef __suffixtree__
 #define __suffixtree__
 
+#include <deque>
+#include <map>
+#include <vector>
 #include "treebank.h"
 
 using ns_treebank::Treebank;
@@ -64,13 +67,34 @@ class ctfactory {
     }
 };
 
-class Suffixtree {
+class Suffix_index {
+   // This is the base class of the indexes of the suffixes of the
+   // sentences (of the prefixes if the treebank is reversed) that the
+   // methods st1 to st4 use.
    public:
-      Suffixtree(Treebank& tb) : SS( tb ) {
-         nodecount=2;
-      }
+      virtual ~Suffix_index() { }
+
       int fix; // 1 prefix, 0 suffix
 
+      // This procedure adds sentence i of the treebank.
+      virtual void construct(const int i)=0;
+
+      // This procedure numbers the words that start a part shared by two
+      // or more sentences and stores, for every occurrence of such a part,
+      // the number at the position after it in the prefs (if fix) or sufs
+      // of ft for its sentence.
+      virtual void align(Ftree* ft)=0;
+};
+
+class Suffixtree:public Suffix_index {
+   // Ukkonen's construction of the suffix tree of the sentences. Every node
+   // is a number (1 is the root) and is kept, together with the edge that
+   // leads to it, in a vector. The children of a node are kept in a small
+   // array sorted on the first word of their edge; the root, which has a
+   // child for almost every word, uses a hash table with open addressing.
+   public:
+      Suffixtree(Treebank& tb);
+
       void construct(const int i);
       void align(Ftree* ft);
 
@@ -81,26 +105,45 @@ class Suffixtree {
       int M;    // the size of the current line
       int N;    // the id of the current line
 
-      // mappings
-      map<int,int> slinks_ft; // slinks from-to
-      map<int,int> slinks_tf; // slinks to-from
-
-      class Edge;
       class Suffix;
 
-      void add_prefix( Suffix &active, int pos_stop );
+      struct Node {
+         // A node and its edge: words pos_begin up to and including
+         // pos_end of sentence line_nr, which start at node parent. The
+         // children are child_table[first_child] onwards (not the root).
+         int parent;
+         int slink;        // suffix link (0 if none)
+         int line_nr;
+         int pos_begin;
+         int pos_end;
+         int first_child;
+         int children;
+         int capacity;     // room in child_table from first_child
+      };
+
+      struct Child {
+         int word;         // index of the first word of the edge
+         int node;         // 0 marks a free entry of the root table
+      };
+
+      vector<Node> nodes;
+      // For each node, the end positions of the occurrences of its edge
+      // per sentence
+      deque<senpos> posities;
+      vector<Child> child_table;
+      vector<Child> root_table; // size is a power of two
+      int root_children;
 
-      typedef map<int,Edge> Edgecol;
-      map<int,Edgecol> Edges;
-      map<int,int> prevnode;
+      void add_prefix( Suffix &active, int pos_stop );
 
-      void  add_edge( Edge &e );
-      void  del_edge( Edge &e );
-      int split_edge( Edge &e, Suffix &s );
+      int   new_node( int line_nr, int pos_begin, int pos_end, int parent );
+      int   child( int node, int word ) const;
+      void  set_child( int node, int word, int child );
+      void  add_edge( int node );
+      int split_edge( int node, Suffix &s );
 
       void add_slink( int node_from, int node_to );
-      int get_slink_ft( int node_from );
-      int get_slink_tf( int node_to );
+      int get_slink_ft( int node_from ) const;
 
       void cano_suffix( Suffix &s );
 };
@@ -117,24 +160,6 @@ class Suffixtree::Suffix {
     int Explicit(){ return (pos_start >  pos_stop); }
 };
 
-class Suffixtree::Edge {
-  public :
-    senpos posities;
-    int line_nr;
-    int pos_begin;
-    int pos_end;
-    int node_begin;
-    int node_end;
-    Edge(){};
-    Edge( int line_nr,
-          int init_pos_begin,
-          int init_pos_end,
-          int node_parent,
-          int node_child);
-
-    void adjust_points(int l);
-};
-
 
 } // namespace
 
@@ -0,0 +1,220 @@
+/******************************************************************************»
+ **
+ **   Filename    : thread_pool.h
+ **
+ **   Description : This file contains the definition of the class
+ **                 Thread_pool. A pool of n threads (the calling thread
+ **                 and n-1 worker threads) runs the jobs of a Task. Every
+ **                 thread starts with a queue of consecutive jobs and
+ **                 takes them one by one from the front. A thread whose
+ **                 queue is empty steals from the back of the longest
+ **                 queue, so the threads share the work even when the
+ **                 jobs differ in size. Without POSIX threads all jobs
+ **                 run in the calling thread.
+ **
+ **   Version     : $Id$
+ **
+ ******************************************************************************»
+ **   This file is part of the Alignment-Based Learning package
+ **
+ **   See the file "LICENCE" for information on usage and redistribution
+ **   of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ ******************************************************************************»
+ */
+
+#ifndef __thread_pool__
+#define __thread_pool__
+
+#include <utility>
+#include <vector>
+#include "config.h"
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+namespace ns_thread_pool {
+
+class Task {
+   // This is the base class of the work given to a Thread_pool. The jobs
+   // of a task must be independent: they may run in any order and at the
+   // same time.
+public:
+   virtual ~Task() { }
+
+   // This procedure does job number job. thread is the number of the
+   // thread (0 is the calling thread) and can be used to select scratch
+   // space.
+   virtual void run(const int job, const int thread)=0;
+};
+
+class Thread_pool {
+public:
+   // This procedure starts n-1 worker threads, which wait for work.
+   Thread_pool(const int n=1) throw():threads(1) {
+#ifdef HAVE_PTHREAD_H
+      pthread_mutex_init(&lock, 0);
+      pthread_cond_init(&start, 0);
+      pthread_cond_init(&done, 0);
+      task=0;
+      round=0;
+      busy=0;
+      stop=false;
+      workers.resize(n > 1?n-1:0);
+      for (int i=0; i<int(workers.size()); i++) {
+         workers[i].pool=this;
+         workers[i].number=i+1;
+         if (pthread_create(&workers[i].thread, 0, work, &workers[i]) != 0) {
+            workers.resize(i);
+            break;
+         }
+      }
+      threads=1+workers.size();
+#endif
+   }
+
+   ~Thread_pool() {
+#ifdef HAVE_PTHREAD_H
+      pthread_mutex_lock(&lock);
+      stop=true;
+      pthread_cond_broadcast(&start);
+      pthread_mutex_unlock(&lock);
+      for (int i=0; i<int(workers.size()); i++) {
+         pthread_join(workers[i].thread, 0);
+      }
+      pthread_cond_destroy(&done);
+      pthread_cond_destroy(&start);
+      pthread_mutex_destroy(&lock);
+#endif
+   }
+
+   // Return the number of threads, including the calling thread.
+   int size() const throw() { return threads; }
+
+   // This procedure runs jobs 0 to jobs-1 of t and returns when all of
+   // them are done. The jobs are divided evenly over the threads.
+   void run(Task& t, const int jobs) throw() {
+      vector<int> first;
+      for (int i=0; i<=threads; i++) {
+         first.push_back(int((double(jobs)*i)/threads));
+      }
+      run(t, first);
+   }
+
+   // This procedure runs the jobs of t and returns when all of them are
+   // done. Thread i starts with the jobs first[i] to first[i+1]-1, so
+   // first holds size()+1 ascending numbers.
+   void run(Task& t, const vector<int>& first) throw() {
+#ifdef HAVE_PTHREAD_H
+      if (!workers.empty()) {
+         pthread_mutex_lock(&lock);
+         task=&t;
+         queues.clear();
+         for (int i=0; i<threads; i++) {
+            queues.push_back(make_pair(first[i], first[i+1]));
+         }
+         busy=workers.size();
+         round++;
+         pthread_cond_broadcast(&start);
+         pthread_mutex_unlock(&lock);
+         run_jobs(0);
+         pthread_mutex_lock(&lock);
+         while (busy > 0) {
+            pthread_cond_wait(&done, &lock);
+         }
+         task=0;
+         pthread_mutex_unlock(&lock);
+         return;
+      }
+#endif
+      for (int j=first.front(); j<first.back(); j++) {
+         t.run(j, 0);
+      }
+   }
+
+private:
+   Thread_pool(const Thread_pool&);
+   Thread_pool& operator=(const Thread_pool&);
+
+   int threads;
+#ifdef HAVE_PTHREAD_H
+   struct Worker {
+      Thread_pool* pool;
+      int number;
+      pthread_t thread;
+   };
+
+   // This procedure takes jobs from the front of the queue of thread and,
+   // when that is empty, from the back of the longest queue until there
+   // are no jobs left.
+   void run_jobs(const int thread) throw() {
+      for (;;) {
+         int job=-1;
+         pthread_mutex_lock(&lock);
+         pair<int, int>& own=queues[thread];
+         if (own.first < own.second) {
+            job=own.first++;
+         } else {
+            int victim=thread;
+            for (int i=0; i<threads; i++) {
+               if (queues[i].second-queues[i].first
+                 > queues[victim].second-queues[victim].first) {
+                  victim=i;
+               }
+            }
+            if (victim != thread) {
+               job=--queues[victim].second;
+            }
+         }
+         pthread_mutex_unlock(&lock);
+         if (job < 0) {
+            return;
+         }
+         task->run(job, thread);
+      }
+   }
+
+   // This procedure is the main loop of a worker thread: wait for a new
+   // round, do jobs, report that the round is done.
+   static void* work(void* arg) {
+      Worker* w=(Worker*)arg;
+      Thread_pool* p=w->pool;
+      int seen=0;
+      pthread_mutex_lock(&p->lock);
+      for (;;) {
+         while ((p->round == seen)&&(!p->stop)) {
+            pthread_cond_wait(&p->start, &p->lock);
+         }
+         if (p->stop) {
+            break;
+         }
+         seen=p->round;
+         pthread_mutex_unlock(&p->lock);
+         p->run_jobs(w->number);
+         pthread_mutex_lock(&p->lock);
+         if (--p->busy == 0) {
+            pthread_cond_signal(&p->done);
+         }
+      }
+      pthread_mutex_unlock(&p->lock);
+      return 0;
+   }
+
+   vector<Worker> workers;
+   pthread_mutex_t lock;
+   pthread_cond_t start;  // signals a new round (or stop)
+   pthread_cond_t done;   // signals that all workers finished the round
+   Task* task;
+   vector<pair<int, int> > queues; // jobs left of each thread: [first, second)
+   int round;
+   int busy;              // workers that have not finished the round
+   bool stop;
+#endif
+};
+
+
+} // namespace
+
+#endif // __thread_pool__
@@ -17,6 +17,8 @@
  ******************************************************************************»
  */
 
+#include <algorithm>
+#include <utility>
 #include "tree.h"
 #include "treebank.h"
 
@@ -37,6 +39,59 @@ void Treebank::doReverse() {
    }
 }
 
+void Treebank::collapse(Treebank& all, vector<int>& copies) {
+   all.clear();
+   swap(all);
+   vector<pair<unsigned long, int> > order; // (hash of sentence, tree)
+   for (Treebank::size_type i=0; i<all.size(); i++) {
+      unsigned long h=all[i].size();
+      for (Tree::const_iterator w=all[i].begin(); w != all[i].end(); ++w) {
+         h=h*1000003+w->getIdx();
+      }
+      order.push_back(make_pair(h, int(i)));
+   }
+   sort(order.begin(), order.end());
+   copies.resize(all.size());
+   for (size_type b=0; b<order.size(); ) {
+      size_type e=b+1;
+      while ((e < order.size())&&(order[e].first == order[b].first)) {
+         e++;
+      }
+      // trees with equal hashes are compared with the earlier ones
+      for (size_type k=b; k<e; k++) {
+         int t=order[k].second;
+         copies[t]=t;
+         for (size_type l=b; l<k; l++) {
+            int u=order[l].second;
+            if ((copies[u] == u)
+              &&((const Sentence&)all[u] == (const Sentence&)all[t])) {
+               copies[t]=u;
+               break;
+            }
+         }
+      }
+      b=e;
+   }
+   for (Treebank::size_type i=0; i<all.size(); i++) {
+      if (copies[i] == int(i)) {
+         copies[i]=size();
+         push_back(all[i]);
+      } else {
+         copies[i]=copies[copies[i]];
+      }
+   }
+}
+
+void Treebank::expand(Treebank& all, const vector<int>& copies) {
+   for (Treebank::size_type i=0; i<all.size(); i++) {
+      string comment_line=all[i].comment_line;
+      all[i]=(*this)[copies[i]];
+      all[i].comment_line=comment_line;
+   }
+   swap(all);
+   all.clear();
+}
+
 void Treebank::write_partial(ostream& os) const throw() {
    os << ":" << current << endl << endl;
    for(Treebank::const_iterator i=begin(); i != end(); i++) {
@@ -71,10 +126,9 @@ void Treebank::read(istream& is) throw() {
          comments.push_back(t.comment_line);
       }
 
-      // keep track of sentence relation when not exhaustive comparison
+      // number the sentences when not exhaustive comparison
       if (!exhaustive) {
          t.setID(++cnt);
-         t.regWordsInSentence();
       }
 
       // add tree to treebank
@@ -3,9 +3,10 @@
  **   Filename    : treebank.h
  **
  **   Description : This file contains the definition of the class Treebank.
- **                 A treebank is effectively a list of trees. Note that it
- **                 is useful (when aligning) to insert unique trees only.
- **                 This implementation does not do this.
+ **                 A treebank is effectively a list of trees. When
+ **                 aligning, it is useful to keep unique trees only: the
+ **                 treebank can be collapsed to its distinct sentences and
+ **                 later expanded to all trees again.
  **
  **   Version     : $Id: treebank.h 3755 2010-02-19 11:23:46Z menno $
  **
@@ -51,6 +52,17 @@ public:
 
    void doReverse();
 
+   // This procedure moves the trees of the treebank to all and keeps one
+   // tree for each distinct sentence (in the order of first occurrence).
+   // copies gets, for every tree in all, the position of its sentence in
+   // the treebank.
+   void collapse(Treebank& all, vector<int>& copies);
+
+   // This procedure undoes collapse: tree i of all gets the sentence and
+   // structure of tree copies[i] of the treebank and the trees of all are
+   // moved back to the treebank.
+   void expand(Treebank& all, const vector<int>& copies);
+
    // Definitions supporting iteration over the treebank.
    Treebank::size_type current_index() const throw() { return current; }
    void inc_current_index() throw() { current++; }
@@ -4,15 +4,13 @@
  **
  **   Description : This file contains the definition of the class
  **                 Wagner-fisher. It implements the Wagner Fisher edit
- **                 distance algorithm. Wagner_fisher should still be an
- **                 abstract base class, where only the gamma function is
- **                 still abstract. The WF_min_edit_distance class is derived
- **                 from the Wagner_fisher class. This class has the gamma 
- **                 function instantiated. It should find the minimum edit¶
- **                 distance between two sentences (ins=del=1, sub=2, mat=0).
- **                 WF_biased_edit_distance is also derived from the
- **                 Wagner_fisher class. The distance function is the biased
- **                 distance function (ins=del=1, sub=2,
+ **                 distance algorithm. Wagner_fisher is parameterised with
+ **                 a cost policy (see edit_operations.h). The WF_default
+ **                 class uses the Default policy. It should find the
+ **                 minimum edit distance between two sentences (ins=del=1,
+ **                 sub=2, mat=0). WF_biased uses the Biased policy. The
+ **                 distance function is the biased distance function
+ **                 (ins=del=1, sub=2,
  **                 mat=((index_S/|S|)-(index_T/|T|))*mean(|S|,|T|)
  **
  **   Version     : $Id: wagner_fisher.h 3755 2010-02-19 11:23:46Z menno $
@@ -28,6 +26,8 @@
 #ifndef __wagner_fisher__
 #define __wagner_fisher__
 
+#include <algorithm>
+#include <cstdlib>
 #include <vector>
 #include "edit_distance.h"
 #include "edit_operations.h"
@@ -43,71 +43,258 @@ void write_matrix(vector<vector<float> > d) {
    }
 }
 
-// Ran needs to be a random access iterator.
-template <class Ran>
+// Value of the cells that fall outside the diagonal band. It is large
+// enough never to be chosen, but adding a gamma to it stays finite.
+const float out_of_band=1e30;
+
+struct Bounds {
+   // This class limits the part of the edit distance matrix that is
+   // filled and kept in memory. A negative value means that there is no
+   // limit.
+   Bounds(float d=-1, int w=-1, double c=-1) throw()
+     :max_distance(d),band(w),max_cells(c) { }
+   float max_distance;   // pairs with a higher edit cost are abandoned
+   int band;             // half width of the diagonal band
+   double max_cells;     // larger matrices are aligned in linear space
+};
+
+// Ran needs to be a random access iterator, Cost a cost policy.
+template <class Ran, class Cost>
 class Wagner_fisher:public Edit_distance {
 public:
-   // This procedure builds the edit distance matrix and the alignment
-   // (see class Edit_distance).
-   Wagner_fisher(Ran b1, Ran e1, Ran b2, Ran e2, vector<Edit_operation*> op)
-     throw():Edit_distance(op) {
-      build_matrix(b1, e1, b2, e2);
-      build_alignment();
+   // This procedure builds the edit distance matrix (in buf) and the
+   // alignment (see class Edit_distance). When the bounds show that the
+   // edit cost exceeds max_distance, the pair is abandoned and no alignment
+   // is built. When the matrix has more than max_cells cells, only a few
+   // rows are kept at a time (see build_linear).
+   Wagner_fisher(Ran b1, Ran e1, Ran b2, Ran e2, Dp_buffer& buf,
+     const Bounds& bounds=Bounds()) throw()
+     :Edit_distance(&buf),cost(b1, e1, b2, e2),begin1(b1),begin2(b2),
+      linear(false) {
+      len1=e1-b1;
+      len2=e2-b2;
+      diff=len2-len1;
+      width=-1;
+      max_cells=bounds.max_cells;
+      if (bounds.max_distance >= 0) {
+         if (abs(diff) > bounds.max_distance) {
+            abandoned_flag=true;
+            return;
+         }
+         width=int((bounds.max_distance-abs(diff))/2);
+      }
+      if ((bounds.band >= 0)&&((width < 0)||(bounds.band < width))) {
+         width=bounds.band;
+      }
+      if ((max_cells >= 0)&&(double(len1+1)*(len2+1) > max_cells)) {
+         linear=true;
+         build_linear(bounds.max_distance);
+      } else {
+         build_matrix(bounds.max_distance);
+         if (!abandoned()) {
+            build_alignment();
+         }
+      }
    }
    ~Wagner_fisher() {}
 
 private:
-   void build_matrix(Ran b1, Ran e1, Ran b2, Ran e2) throw() {
-      len1=len2=0;
-      for (; b2!=e2;b2++) { len2++; }
-      matrix.push_back(vector<float>(len2+1,float(0)));
-      for (; b1!=e1;b1++) {
-         len1++;
-         matrix.push_back(vector<float>(len2+1,float(0)));
+   // Return the minimal cost of cell (i, j) and the first operation (in
+   // the order INS, DEL, SUB) that reaches it. prev holds row i-1 and curr
+   // row i of the matrix.
+   pair<float, Edit_operation>
+   min_gamma(const int i, const int j, const float* prev, const float* curr)
+     const throw() {
+      if (i == 0) {
+         return make_pair(curr[j-1]+cost.del(), DEL);
+      }
+      pair<float, Edit_operation> min(prev[j]+cost.ins(), INS);
+      if (j > 0) {
+         float next=curr[j-1]+cost.del();
+         if (next < min.first) {
+            min=make_pair(next, DEL);
+         }
+         next=prev[j-1]+cost.sub(i, j);
+         if (next < min.first) {
+            min=make_pair(next, SUB);
+         }
+      }
+      return min;
+   }
+
+   // This procedure fills row i of the matrix (curr and dirs) from row i-1
+   // (prev). Only the cells (i, j) with j-i within the band around the
+   // diagonal are filled (Ukkonen). The band is widened by the difference
+   // in length, so (len1, len2) can always be reached. Any path through
+   // (i, j) costs at least |j-i|+|(len2-len1)-(j-i)|, so a maximum edit
+   // distance also bounds the band, and row_min is set to the lowest cost
+   // of a path through row i. The cells just outside the band are set to
+   // out_of_band, so they are never chosen by the cells inside.
+   void fill_row(const int i, const float* prev, float* curr,
+     unsigned char* dirs, float& row_min) throw() {
+      int lo=0, hi=len2;
+      if (width >= 0) {
+         lo=max(0, i+min(0, diff)-width);
+         hi=min(len2, i+max(0, diff)+width);
+         if (lo > 0) {
+            curr[lo-1]=out_of_band;
+         }
+         if (hi < len2) {
+            curr[hi+1]=out_of_band;
+         }
       }
+      row_min=out_of_band;
+      cells_computed+=hi-lo+1;
+      for (int j=lo; j <= hi; j++) {
+         if ((i == 0)&&(j == 0)) {
+            curr[j]=0; // init step
+         } else {
+            pair<float, Edit_operation> m=min_gamma(i, j, prev, curr);
+            curr[j]=m.first;
+            dirs[j]=m.second;
+         }
+         row_min=min(row_min, curr[j]+abs(diff-(j-i)));
+      }
+   }
+
+   // This procedure fills the matrix. The pair is abandoned as soon as no
+   // cell in a row can lead to an acceptable cost.
+   void build_matrix(const float max_distance) throw() {
+      buffer->resize(len1+1, len2+1);
       for (int i=0; i <= len1; i++) {
-         for (int j=0; j <= len2; j++) {
-            if ((i == 0)&&(j == 0)) {
-               continue; // init step
-            }
-            pair<float, const Edit_operation*> m=min_gamma(make_pair(i, j));
-            matrix[i][j]=m.first;
+         float row_min;
+         fill_row(i, (i == 0)?0:&buffer->cost(i-1, 0), &buffer->cost(i, 0),
+           &buffer->direction(i, 0), row_min);
+         if ((max_distance >= 0)&&(row_min > max_distance)) {
+            abandoned_flag=true;
+            return;
          }
       }
    }
 
+   // This procedure follows the directions stored with the cells from
+   // (len1, len2) back to (0, 0).
    void build_alignment() throw() {
       pair<int, int> curr_coor=make_pair(len1, len2);
       while(!((curr_coor.first == 0) && (curr_coor.second == 0))) {
-         pair<float, const Edit_operation*> m=min_gamma(curr_coor);
-         alignment.insert(alignment.begin(), m.second);
-         curr_coor=m.second->prev_coord(curr_coor);
+         Edit_operation op=Edit_operation(
+           buffer->direction(curr_coor.first, curr_coor.second));
+         curr_coor=prev_coord(op, curr_coor);
+         add_operation(op, curr_coor);
+      }
+      reverse(alignment.begin(), alignment.end());
+   }
+
+   // This procedure adds the operation op that starts at words p (in
+   // reverse, see add_backwards).
+   void add_operation(const Edit_operation op, const pair<int, int> p)
+     throw() {
+      add_backwards(alignment, ((op == SUB)
+        &&(*(begin1+p.first) == *(begin2+p.second)))?SAME:DIFF,
+        p.first, p.second);
+   }
+
+   // This procedure computes row to (in result) from row from (given in
+   // row, unless from is 0), keeping two rows at a time. The pair is
+   // abandoned as soon as no cell in a row can lead to an acceptable cost.
+   void forward(const int from, const vector<float>& row, const int to,
+     vector<float>& result, const float max_distance) throw() {
+      vector<float> rows(2*(len2+1));
+      vector<unsigned char> dirs(len2+1);
+      float row_min;
+      if (from == 0) {
+         fill_row(0, 0, &rows[0], &dirs[0], row_min);
+      } else {
+         copy(row.begin(), row.end(), rows.begin()+(from%2)*(len2+1));
+      }
+      for (int i=from+1; i <= to; i++) {
+         fill_row(i, &rows[((i-1)%2)*(len2+1)], &rows[(i%2)*(len2+1)],
+           &dirs[0], row_min);
+         if ((max_distance >= 0)&&(row_min > max_distance)) {
+            abandoned_flag=true;
+            return;
+         }
+      }
+      result.assign(rows.begin()+(to%2)*(len2+1),
+        rows.begin()+(to%2+1)*(len2+1));
+   }
+
+   // This procedure adds (in reverse) the operations of the path from
+   // (b, c) up to row a, given the costs of row a, and returns the column
+   // in which the path reaches row a. When rows a to b fit in max_cells
+   // cells, they are filled in the buffer and the stored directions are
+   // followed. Otherwise the costs of the middle row are computed and the
+   // lower half is traced before the upper half. The cells get the same
+   // costs and directions as in the full matrix, so the path is the same.
+   int trace(const int a, const vector<float>& row, const int b, int c)
+     throw() {
+      if ((b-a == 1)||(double(b-a+1)*(len2+1) <= max_cells)) {
+         buffer->resize(b-a+1, len2+1);
+         copy(row.begin(), row.end(), &buffer->cost(0, 0));
+         for (int i=a+1; i <= b; i++) {
+            float row_min;
+            fill_row(i, &buffer->cost(i-a-1, 0), &buffer->cost(i-a, 0),
+              &buffer->direction(i-a, 0), row_min);
+         }
+         pair<int, int> curr_coor=make_pair(b, c);
+         while (curr_coor.first > a) {
+            Edit_operation op=Edit_operation(
+              buffer->direction(curr_coor.first-a, curr_coor.second));
+            curr_coor=prev_coord(op, curr_coor);
+            add_operation(op, curr_coor);
+         }
+         return curr_coor.second;
+      }
+      int m=(a+b)/2;
+      vector<float> middle;
+      forward(a, row, m, middle, -1);
+      c=trace(m, middle, b, c);
+      return trace(a, row, m, c);
+   }
+
+   // This procedure builds the alignment keeping O(len2 log len1) costs in
+   // memory next to a block of at most max_cells cells (Hirschberg). With
+   // a maximum edit distance, all rows are checked in a first pass.
+   void build_linear(const float max_distance) throw() {
+      vector<float> row;
+      if (max_distance >= 0) {
+         forward(0, row, len1, row, max_distance);
+         if (abandoned()) {
+            return;
+         }
+      }
+      forward(0, row, 0, row, -1);
+      int c=(len1 > 0)?trace(0, row, len1, len2):len2;
+      while (c > 0) { // row 0
+         c--;
+         add_operation(DEL, make_pair(0, c));
       }
+      reverse(alignment.begin(), alignment.end());
    }
 
+   Cost cost;
+   Ran begin1, begin2;
    int len1, len2;
+   int diff;             // len2-len1
+   int width;            // half width of the band (negative if none)
+   double max_cells;
+   bool linear;
 };
 
 template <class Ran>
-class WF_default:public Wagner_fisher<Ran> {
+class WF_default:public Wagner_fisher<Ran, Default<Ran> > {
 public:
-   WF_default(Ran b1, Ran e1, Ran b2, Ran e2) throw()
-   :Wagner_fisher<Ran>(b1, e1, b2, e2,
-      *(storage=new Default<Ran>(b1, e1, b2, e2))) { }
-   ~WF_default() { delete storage; }
-private:
-   Default<Ran>* storage;
+   WF_default(Ran b1, Ran e1, Ran b2, Ran e2, Dp_buffer& buf,
+     const Bounds& b=Bounds()) throw()
+   :Wagner_fisher<Ran, Default<Ran> >(b1, e1, b2, e2, buf, b) { }
 };
 
 template <class Ran>
-class WF_biased:public Wagner_fisher<Ran> {
+class WF_biased:public Wagner_fisher<Ran, Biased<Ran> > {
 public:
-   WF_biased(Ran b1, Ran e1, Ran b2, Ran e2) throw()
-   :Wagner_fisher<Ran>(b1, e1, b2, e2,
-      *(storage=new Biased<Ran>(b1, e1, b2, e2))) { }
-   ~WF_biased() { delete storage; }
-private:
-   Biased<Ran>* storage;
+   WF_biased(Ran b1, Ran e1, Ran b2, Ran e2, Dp_buffer& buf,
+     const Bounds& b=Bounds()) throw()
+   :Wagner_fisher<Ran, Biased<Ran> >(b1, e1, b2, e2, buf, b) { }
 };
 
 
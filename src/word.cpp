@@ -24,15 +24,10 @@ namespace ns_word {
 typedef vector<int> vecul;
 map<string, int> Word::wrd2idx;
 map<int, string> Word::idx2wrd;
-map<int, vecul> Word::idx2sens;
 
 bool isValid(const string&) throw();
 bool isValid(const char) throw();
 
-void Word::addSenToWord(int sen) throw() {
-   idx2sens[idx].push_back(sen);
-}
-
 void Word::storeWord(const string& w) throw() {
    if(wrd2idx.count(w) == 0) {
       idx = wrd2idx.size() + 1;
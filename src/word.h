@@ -71,7 +71,6 @@ class Word {
       int idx;                           // index of current word
       static map<string, int> wrd2idx;   // mapping word  ->index
       static map<int, string> idx2wrd;   // mapping index -> word
-      static map<int, vecul> idx2sens;   // mapping index -> sens
 
    public:
 
@@ -79,7 +78,7 @@ class Word {
       Word() throw() { idx=UNDEF; }              // value undefined
       Word(const string&) throw(InvalidWord);
 
-      int getIdx() {
+      int getIdx() const {
          return idx;
       }
 
@@ -87,15 +86,12 @@ class Word {
          return idx2wrd[idx];
       }
 
-      // This procedure registers the use of the current word in a sentence
-      // specified with parameter "sen". 
-      void addSenToWord(int sen) throw();
-
-      // Definitions supporting the iteration over the registered sentences
-      // for the current word.
-      typedef vector<int>::iterator simil_iterator;
-      simil_iterator simil_begin() { return idx2sens[idx].begin(); }
-      simil_iterator simil_end() { return idx2sens[idx].end(); }
+      // The number of distinct words and the word with index i (1 up to
+      // vocabulary_size(), in the order they were first read).
+      static int vocabulary_size() throw() { return idx2wrd.size(); }
+      static const string& vocabulary(const int i) throw() {
+         return idx2wrd[i];
+      }
 
       // operators
       bool operator<(const Word& w) const throw() { return w.idx < idx; }